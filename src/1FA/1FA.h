@@ -90,6 +90,42 @@ public:
             }
     }
 
+/* snapshots, see common/sketch_snapshot.h; 1FA has no seeded hash */
+    void serialize(vector<uint8_t> &out, int encoding = SNAPSHOT_RAW)
+    {
+        snapshot_begin(out, SNAPSHOT_1FA, encoding, 0, bucket_num, COUNTER_PER_BUCKET, 0);
+        snapshot_put_buckets(out, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, encoding);
+        snapshot_finish(out);
+    }
+
+    bool deserialize(const uint8_t *data, size_t len)
+    {
+        const SnapshotHeader *h = snapshot_check(data, len, SNAPSHOT_1FA, bucket_num, COUNTER_PER_BUCKET);
+        if(!h)
+            return false;
+        const uint8_t *p = data + sizeof(SnapshotHeader);
+        heavy_part.clear();
+        if(!snapshot_get_buckets(p, data + len, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, h->encoding))
+        {
+            heavy_part.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // adds the counts of other, see bucket_merge
+    bool merge(const Elastic_1FA &other)
+    {
+        for(int i = 0; i < bucket_num; ++i)
+        {
+            bucket_merge(heavy_part.buckets[i].key, heavy_part.buckets[i].val,
+                         other.heavy_part.buckets[i].key, other.heavy_part.buckets[i].val,
+                         MAX_VALID_COUNTER, 0xFFFFFFFF, [](uint32_t, uint32_t) {});
+            heavy_part.buckets[i].val[MAX_VALID_COUNTER] += other.heavy_part.buckets[i].val[MAX_VALID_COUNTER];
+        }
+        return true;
+    }
+
 /* interface */
  //   int get_compress_width(int ratio) { return light_part.get_compress_width(ratio);}
   //  void compress(int ratio, uint8_t *dst) {    light_part.compress(ratio, dst); }
@@ -189,18 +225,11 @@ public:
 */
     void *operator new(size_t sz)
     {
-        constexpr uint32_t alignment = 64;
-        size_t alloc_size = (2 * alignment + sz) / alignment * alignment;
-        void *ptr = ::operator new(alloc_size);
-        void *old_ptr = ptr;
-        void *new_ptr = ((char*)std::align(alignment, sz, ptr, alloc_size) + alignment);
-        ((void **)new_ptr)[-1] = old_ptr;
-
-        return new_ptr;
+        return sketch_alloc(sz);
     }
     void operator delete(void *p)
     {
-        ::operator delete(((void**)p)[-1]);
+        sketch_free(p);
     }
 };
 
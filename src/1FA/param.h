@@ -2,6 +2,10 @@
 #define _ELASTIC1FA_PARAM_H_
 #define WIN32
 #include "../common/BOBHash32.h"
+#include "../common/bucket_kernel.h"
+#include "../common/latency_hist.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/sketch_alloc.h"
 
 #include <x86intrin.h>
 #include <string.h>
@@ -0,0 +1,342 @@
+#ifndef _COMPACT_2FA_HEAVYPART_H_
+#define _COMPACT_2FA_HEAVYPART_H_
+
+#include "HeavyPart.h"
+
+// 2FASketch buckets of 16-bit fingerprints and 16-bit counters, for memory
+// budgets of a few tens of KB: a 64-byte bucket holds 15 slots and the guard
+// instead of 7. A counter that reaches promote_at moves, with the full key,
+// to a small overflow table of 32-bit counts. Its slot then holds
+// COMPACT_PROMOTED_BIT and the index of the entry, so further hits count in
+// the table without a lookup. Promoted slots compare above any counter and
+// guard, so they are never evicted.
+//
+// The fingerprints do not give the keys back, so the heavy hitters are the
+// promoted keys: promote_at must not be above the reporting threshold. When
+// the overflow table is full, counters saturate at COMPACT_MAX_VAL instead.
+#define COMPACT_COUNTER_PER_BUCKET 16
+#define COMPACT_MAX_VALID_COUNTER 15
+#define COMPACT_PROMOTED_BIT 0x8000
+#define COMPACT_MAX_VAL 0x7FFF
+
+// independent of the bits CalculateBucketPos and CalculateBucketPos2 use
+#define COMPACT_FP_MULTIPLIER 0x85EBCA6Bu
+#define CalculateCompactFP(fp) ((uint16_t)(((fp) * COMPACT_FP_MULTIPLIER) >> 16))
+
+struct alignas(64) CompactBucket
+{
+	uint16_t key[COMPACT_COUNTER_PER_BUCKET];
+	uint16_t val[COMPACT_COUNTER_PER_BUCKET];
+};
+
+// two bits per slot matching fp, as from movemask_epi8: slot i is bits 2i
+// and 2i + 1. The guard lane is left out.
+static inline uint32_t compact_bucket_match(const CompactBucket &bucket, uint16_t fp)
+{
+	const uint32_t valid = (1u << (2 * COMPACT_MAX_VALID_COUNTER)) - 1;
+#ifdef __AVX2__
+	__m256i eq = _mm256_cmpeq_epi16(_mm256_load_si256((const __m256i *)bucket.key), _mm256_set1_epi16((short)fp));
+	return (uint32_t)_mm256_movemask_epi8(eq) & valid;
+#else
+	uint32_t matched = 0;
+	for (int i = 0; i < COMPACT_MAX_VALID_COUNTER; ++i)
+		if (bucket.key[i] == fp)
+			matched |= 3u << (2 * i);
+	return matched;
+#endif
+}
+
+// index of a smallest valid counter, its value in min_val
+static inline int compact_bucket_min(const CompactBucket &bucket, uint32_t &min_val)
+{
+#ifdef __SSE4_1__
+	__m128i lo = _mm_load_si128((const __m128i *)bucket.val);
+	// the guard lane reads as 0xFFFF
+	__m128i hi = _mm_or_si128(_mm_load_si128((const __m128i *)(bucket.val + 8)), _mm_set_epi16(-1, 0, 0, 0, 0, 0, 0, 0));
+	__m128i m = _mm_minpos_epu16(_mm_min_epu16(lo, hi));
+	min_val = (uint32_t)_mm_extract_epi16(m, 0);
+	int j = _mm_extract_epi16(m, 1);
+	return bucket.val[j] == min_val ? j : j + 8;
+#else
+	int min_counter = 0;
+	min_val = bucket.val[0];
+	for (int i = 1; i < COMPACT_MAX_VALID_COUNTER; ++i)
+		if (bucket.val[i] < min_val)
+		{
+			min_val = bucket.val[i];
+			min_counter = i;
+		}
+	return min_counter;
+#endif
+}
+
+// overflow_num must be a power of two; the table is filled to 3/4 at most
+template <int bucket_num, int overflow_num>
+class Compact_2FA_HeavyPart
+{
+	static_assert((overflow_num & (overflow_num - 1)) == 0, "overflow_num must be a power of two");
+	static_assert(overflow_num <= COMPACT_PROMOTED_BIT, "the entry index must fit in a slot");
+
+public:
+	alignas(64) CompactBucket buckets[bucket_num];
+	// linear probing on the full key, a count of 0 is an empty entry; key
+	// and count share a cache line
+	struct
+	{
+		uint32_t key, val;
+	} overflow[overflow_num];
+	int overflow_size;
+	uint32_t promote_at;
+	BOBHash32 *bobhash = NULL;
+	uint32_t seed;
+
+	Compact_2FA_HeavyPart(uint32_t promote_at = COMPACT_MAX_VAL, uint32_t seed = SKETCH_RANDOM_SEED)
+		: promote_at(promote_at < COMPACT_MAX_VAL ? promote_at : COMPACT_MAX_VAL)
+	{
+		clear();
+		this->seed = sketch_seed(seed);
+		bobhash = new BOBHash32(this->seed);
+	}
+	~Compact_2FA_HeavyPart()
+	{
+		delete bobhash;
+	}
+
+	void clear()
+	{
+		memset(buckets, 0, sizeof(CompactBucket) * bucket_num);
+		memset(overflow, 0, sizeof(overflow));
+		overflow_size = 0;
+	}
+
+	// thres_set != 0, first insert, == 0, second insert; returns as
+	// bucket_quick_insert
+	int quick_insert(const uint8_t *key, uint32_t f = 1, uint32_t thres_set = 0)
+	{
+		uint32_t fp;
+		int pos = CalculateFP(key, fp, thres_set == 0);
+		return quick_insert_at(pos, fp, f, thres_set);
+	}
+
+	/* batched insertion, see Elastic_2FA_HeavyPart::insert_batch */
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set)
+	{
+		uint32_t fps[BATCH_PREFETCH_DIST];
+		int poses[BATCH_PREFETCH_DIST];
+
+		size_t warm = n < BATCH_PREFETCH_DIST ? n : BATCH_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
+		{
+			poses[i] = CalculateFP(keys + i * stride, fps[i]);
+			_mm_prefetch((const char *)&buckets[poses[i]], _MM_HINT_T0);
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t slot = i & (BATCH_PREFETCH_DIST - 1);
+			uint32_t fp = fps[slot];
+			int pos = poses[slot];
+
+			size_t ahead = i + BATCH_PREFETCH_DIST;
+			if (ahead < n)
+			{
+				poses[slot] = CalculateFP(keys + ahead * stride, fps[slot]);
+				_mm_prefetch((const char *)&buckets[poses[slot]], _MM_HINT_T0);
+			}
+
+			int res = quick_insert_at(pos, fp, f, thres_set);
+			if (res == thres_set)
+				quick_insert(keys + i * stride, f);
+		}
+	}
+
+	/* query */
+	uint32_t query(const uint8_t *key, int thres_set)
+	{
+		uint32_t fp;
+		int pos = CalculateFP(key, fp);
+		int entry = -1;
+		uint32_t res = slot_count(buckets[pos], fp, entry);
+
+		uint32_t min_val;
+		compact_bucket_min(buckets[pos], min_val);
+		if (min_val >= (uint32_t)thres_set)
+			res += slot_count(buckets[CalculateFP(key, fp, true)], fp, entry);
+
+		// both slots of a key promote to the same entry
+		if (entry >= 0)
+			res += overflow[entry].val;
+		return res;
+	}
+
+	/* heavy hitters: the promoted keys counted at least threshold times,
+	   with what is still counted in their buckets */
+	template <typename Visitor>
+	void for_each_heavy_hitter(int threshold, Visitor &&visit)
+	{
+		for (int i = 0; i < overflow_num; ++i)
+		{
+			if (overflow[i].val == 0)
+				continue;
+			uint32_t key = overflow[i].key, fp;
+			int entry = -1;
+			uint32_t val = overflow[i].val;
+			int primary = CalculateFP((uint8_t *)&key, fp);
+			int backup = CalculateFP((uint8_t *)&key, fp, true);
+			val += slot_count(buckets[primary], fp, entry);
+			if (backup != primary)
+				val += slot_count(buckets[backup], fp, entry);
+			if ((int)val >= threshold)
+				visit(key, (int)val);
+		}
+	}
+
+	/* interface */
+	int get_memory_usage()
+	{
+		return bucket_num * sizeof(CompactBucket) + overflow_num * 2 * sizeof(uint32_t);
+	}
+	int get_bucket_num()
+	{
+		return bucket_num;
+	}
+	int get_overflow_size()
+	{
+		return overflow_size;
+	}
+
+private:
+	int quick_insert_at(int pos, uint32_t key, uint32_t f, uint32_t thres_set)
+	{
+		CompactBucket &bucket = buckets[pos];
+		uint16_t fp = CalculateCompactFP(key);
+
+		uint32_t matched = compact_bucket_match(bucket, fp);
+		if (matched)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
+			add(bucket, __builtin_ctz(matched) >> 1, key, f);
+			return 0;
+		}
+
+		uint32_t min_val;
+		int min_counter = compact_bucket_min(bucket, min_val);
+		if (min_val == 0)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_EMPTY);
+			bucket.key[min_counter] = fp;
+			add(bucket, min_counter, key, f);
+			return 0;
+		}
+
+		if (thres_set != 0 && min_val > thres_set)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_BACKUP);
+			return thres_set;
+		}
+
+		// a guard never reaches a promoted slot
+		uint32_t guard_val = UPDATE_GUARD_VAL(bucket.val[COMPACT_MAX_VALID_COUNTER]);
+		if (!JUDGE_IF_SWAP(min_val, guard_val))
+		{
+			RECORD_INSERT_OUTCOME(INSERT_GUARD);
+			bucket.val[COMPACT_MAX_VALID_COUNTER] = guard_val < COMPACT_MAX_VAL ? guard_val : COMPACT_MAX_VAL;
+			return 2;
+		}
+
+		bucket.val[COMPACT_MAX_VALID_COUNTER] = 0;
+		bucket.key[min_counter] = fp;
+		bucket.val[min_counter] = 0;
+		add(bucket, min_counter, key, guard_val);
+		RECORD_INSERT_OUTCOME(INSERT_SWAP);
+		return 1;
+	}
+
+	// adds f to slot i, which key has; promotes it at promote_at
+	void add(CompactBucket &bucket, int i, uint32_t key, uint32_t f)
+	{
+		if (bucket.val[i] & COMPACT_PROMOTED_BIT)
+		{
+			int j = bucket.val[i] & ~COMPACT_PROMOTED_BIT;
+			// a fingerprint collision with a promoted key gets an entry of its own
+			if (overflow[j].key != key)
+				j = overflow_claim(key);
+			if (j >= 0)
+				overflow[j].val += f;
+			return;
+		}
+		uint32_t val = bucket.val[i] + f;
+		if (val >= promote_at)
+		{
+			int j = overflow_claim(key);
+			if (j >= 0)
+			{
+				overflow[j].val += val;
+				bucket.val[i] = (uint16_t)(COMPACT_PROMOTED_BIT | j);
+				return;
+			}
+		}
+		bucket.val[i] = val < COMPACT_MAX_VAL ? val : COMPACT_MAX_VAL;
+	}
+
+	// the count of key in bucket, or 0 with entry set if it is promoted
+	uint32_t slot_count(const CompactBucket &bucket, uint32_t key, int &entry)
+	{
+		uint32_t matched = compact_bucket_match(bucket, CalculateCompactFP(key));
+		if (!matched)
+			return 0;
+		uint32_t val = bucket.val[__builtin_ctz(matched) >> 1];
+		if (!(val & COMPACT_PROMOTED_BIT))
+			return val;
+		int j = val & ~COMPACT_PROMOTED_BIT;
+		if (overflow[j].key == key)
+			entry = j;
+		else if (entry < 0)
+			entry = overflow_find(key);
+		return 0;
+	}
+
+	static int overflow_pos(uint32_t key)
+	{
+		return (int)((key * CONSTANT_NUMBER) >> 7) & (overflow_num - 1);
+	}
+
+	int overflow_find(uint32_t key)
+	{
+		for (int i = overflow_pos(key);; i = (i + 1) & (overflow_num - 1))
+		{
+			if (overflow[i].val == 0)
+				return -1;
+			if (overflow[i].key == key)
+				return i;
+		}
+	}
+
+	// the entry of key, added if there is room; -1 if the table is full
+	int overflow_claim(uint32_t key)
+	{
+		int i = overflow_pos(key);
+		for (; overflow[i].val != 0; i = (i + 1) & (overflow_num - 1))
+			if (overflow[i].key == key)
+				return i;
+		if (overflow_size >= overflow_num / 4 * 3)
+			return -1;
+		overflow_size++;
+		overflow[i].key = key;
+		return i;
+	}
+
+	int CalculateFP(const uint8_t *key, uint32_t &fp, bool isBackup = false)
+	{
+		fp = *((const uint32_t *)key);
+		if (!isBackup)
+			return CalculateBucketPos(fp) % bucket_num;
+#ifdef BACKUP_SINGLE_HASH
+		return CalculateBucketPos2(fp) % bucket_num;
+#else
+		return bobhash->run((const char *)key, 4) % bucket_num;
+#endif
+	}
+};
+
+#endif
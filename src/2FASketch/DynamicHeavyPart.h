@@ -0,0 +1,253 @@
+#ifndef _DYNAMIC_2FA_HEAVYPART_H_
+#define _DYNAMIC_2FA_HEAVYPART_H_
+
+#include "HeavyPart.h"
+#include <stdexcept>
+
+// Same buckets and kernel as Elastic_2FA_HeavyPart, but the bucket array is
+// sized at runtime and allocated out of line by sketch_alloc, with the
+// process-wide policy or one of its own (hugepages, NUMA node). Bucket
+// positions use the high bits of the hash: a shift when bucket_num is a
+// power of two, Lemire's multiply-shift reduction otherwise, instead of
+// % bucket_num.
+class Dynamic_2FA_HeavyPart
+{
+public:
+	Bucket *buckets = NULL;
+	BOBHash32 *bobhash = NULL;
+	uint32_t seed;
+	int cnt, cnt_all;
+
+	// use_hugepage asks for 2MB pages, falling back to transparent ones;
+	// throws std::invalid_argument if bucket_num is 0
+	Dynamic_2FA_HeavyPart(size_t bucket_num, bool use_hugepage = false, uint32_t seed = SKETCH_RANDOM_SEED)
+		: Dynamic_2FA_HeavyPart(bucket_num, hugepage_policy(use_hugepage), seed){}
+
+	Dynamic_2FA_HeavyPart(size_t bucket_num, const SketchAllocPolicy &policy, uint32_t seed = SKETCH_RANDOM_SEED)
+		: bucket_num(bucket_num), policy(policy)
+	{
+		if (bucket_num == 0)
+			throw std::invalid_argument("Dynamic_2FA_HeavyPart needs at least one bucket");
+		pos_shift = 0;
+		if (bucket_num > 1 && (bucket_num & (bucket_num - 1)) == 0)
+			pos_shift = 32 - __builtin_ctzll(bucket_num);
+
+		alloc_buckets();
+		clear();
+		this->seed = sketch_seed(seed);
+		bobhash = new BOBHash32(this->seed);
+	}
+	~Dynamic_2FA_HeavyPart()
+	{
+		free_buckets();
+		delete bobhash;
+	}
+
+	void clear()
+	{
+		cnt = 0, cnt_all = 0;
+		memset(buckets, 0, sizeof(Bucket) * bucket_num);
+	}
+
+	// thres_set != 0, first insert, == 0, second insert
+	int quick_insert(uint8_t *key, uint32_t f = 1, uint32_t thres_set = 0)
+	{
+		uint32_t fp;
+		size_t pos = CalculateFP(key, fp, thres_set == 0);
+		return bucket_quick_insert(buckets[pos], fp, f, thres_set, cnt, cnt_all);
+	}
+
+	/* batched insertion, see Elastic_2FA_HeavyPart::insert_batch */
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set)
+	{
+		uint32_t fps[BATCH_PREFETCH_DIST];
+		size_t poses[BATCH_PREFETCH_DIST];
+
+		size_t warm = n < BATCH_PREFETCH_DIST ? n : BATCH_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
+		{
+			poses[i] = CalculateFP((uint8_t *)(keys + i * stride), fps[i]);
+			prefetch_bucket(&buckets[poses[i]]);
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t slot = i & (BATCH_PREFETCH_DIST - 1);
+			uint32_t fp = fps[slot];
+			size_t pos = poses[slot];
+
+			size_t ahead = i + BATCH_PREFETCH_DIST;
+			if (ahead < n)
+			{
+				poses[slot] = CalculateFP((uint8_t *)(keys + ahead * stride), fps[slot]);
+				prefetch_bucket(&buckets[poses[slot]]);
+			}
+
+			int res = bucket_quick_insert(buckets[pos], fp, f, thres_set, cnt, cnt_all);
+			if (res == thres_set)
+				quick_insert((uint8_t *)(keys + i * stride), f);
+		}
+	}
+
+	/* query */
+	uint32_t query(uint8_t *key, int thres_set)
+	{
+		uint32_t fp;
+		size_t pos = CalculateFP(key, fp);
+
+		uint32_t res = 0, min_cnt = UINT32_MAX;
+		for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		{
+			if (buckets[pos].key[i] == fp)
+				res += buckets[pos].val[i];
+			min_cnt = min(min_cnt, buckets[pos].val[i]);
+		}
+		if (min_cnt >= thres_set)
+		{
+			pos = CalculateFP(key, fp, true);
+			for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+				if (buckets[pos].key[i] == fp)
+					res += buckets[pos].val[i];
+		}
+
+		return res;
+	}
+
+	/* heavy hitters, see Elastic_2FA_HeavyPart::for_each_heavy_hitter */
+	template <typename Visitor>
+	void for_each_heavy_hitter(int threshold, Visitor &&visit)
+	{
+		uint32_t half = threshold > 1 ? (threshold + 1) / 2 : 1;
+		for (size_t i = 0; i < bucket_num; ++i)
+		{
+			uint32_t mask = bucket_slots_at_least(buckets[i], half);
+			while (mask)
+			{
+				int j = __builtin_ctz(mask);
+				mask &= mask - 1;
+				uint32_t fp = buckets[i].key[j];
+				uint32_t val = buckets[i].val[j];
+
+				size_t other;
+				if (other_bucket(i, fp, other))
+				{
+					uint32_t other_val = bucket_counter_of(buckets[other], fp);
+					if (other_val >= half && other < i)
+						continue;
+					val += other_val;
+				}
+				if ((int)val >= threshold)
+					visit(fp, (int)val);
+			}
+		}
+	}
+
+	void set_seed(uint32_t seed)
+	{
+		this->seed = sketch_seed(seed);
+		bobhash->initialize(this->seed);
+	}
+
+	// see Elastic_2FA_HeavyPart::merge
+	void merge(const Dynamic_2FA_HeavyPart &other)
+	{
+		for (size_t i = 0; i < bucket_num; ++i)
+		{
+			bucket_merge(buckets[i].key, buckets[i].val, other.buckets[i].key, other.buckets[i].val,
+						 MAX_VALID_COUNTER, 0xFFFFFFFF, [](uint32_t, uint32_t) {});
+			buckets[i].val[MAX_VALID_COUNTER] += other.buckets[i].val[MAX_VALID_COUNTER];
+		}
+		cnt += other.cnt, cnt_all += other.cnt_all;
+	}
+
+	// Takes the buckets at offset in a private mapping of size bytes, e.g. a
+	// raw snapshot file, in place of the allocated ones. The mapping is
+	// unmapped with the heavy part.
+	void adopt_mapping(void *base, size_t size, size_t offset)
+	{
+		free_buckets();
+		map_base = base;
+		map_size = size;
+		buckets = (Bucket *)((char *)base + offset);
+		cnt = 0, cnt_all = 0;
+	}
+
+	/* interface */
+	size_t get_memory_usage()
+	{
+		return bucket_num * sizeof(Bucket);
+	}
+	size_t get_bucket_num() const
+	{
+		return bucket_num;
+	}
+	// the SketchPages the buckets got, 4KB pages for a mapped snapshot
+	int get_pages()
+	{
+		return map_base ? SKETCH_PAGES_DEFAULT : sketch_alloc_pages(buckets);
+	}
+
+private:
+	size_t bucket_num;
+	int pos_shift;
+	SketchAllocPolicy policy;
+	void *map_base = NULL;	// set by adopt_mapping
+	size_t map_size;
+
+	static SketchAllocPolicy hugepage_policy(bool use_hugepage)
+	{
+		SketchAllocPolicy policy = sketch_alloc_policy();
+		if (use_hugepage)
+			policy.pages = SKETCH_PAGES_2M;
+		return policy;
+	}
+
+	size_t reduce(uint32_t hash_val)
+	{
+		if (pos_shift)
+			return hash_val >> pos_shift;
+		return ((uint64_t)hash_val * bucket_num) >> 32;
+	}
+
+	// the bucket other than pos that key fp can be stored in, false if none
+	bool other_bucket(size_t pos, uint32_t fp, size_t &other)
+	{
+		uint32_t key = fp;
+		size_t primary = CalculateFP((uint8_t *)&key, fp);
+		size_t backup = CalculateFP((uint8_t *)&key, fp, true);
+		if (primary == backup || (pos != primary && pos != backup))
+			return false;
+		other = pos == primary ? backup : primary;
+		return true;
+	}
+
+	size_t CalculateFP(uint8_t *key, uint32_t &fp, bool isBackup = false)
+	{
+		fp = *((uint32_t *)key);
+		if (!isBackup)
+			return reduce(fp * CONSTANT_NUMBER);
+#ifdef BACKUP_SINGLE_HASH
+		return reduce(fp * ANOTHER_BIG_PRIME_NUMBER);
+#else
+		return reduce(bobhash->run((const char *)key, 4));
+#endif
+	}
+
+	void alloc_buckets()
+	{
+		buckets = (Bucket *)sketch_alloc(bucket_num * sizeof(Bucket), policy);
+	}
+
+	void free_buckets()
+	{
+		if (map_base)
+			munmap(map_base, map_size);
+		else
+			sketch_free(buckets);
+	}
+
+	Dynamic_2FA_HeavyPart(const Dynamic_2FA_HeavyPart &);
+	Dynamic_2FA_HeavyPart &operator=(const Dynamic_2FA_HeavyPart &);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _FIVE_TUPLE_2FASketch_H_
+#define _FIVE_TUPLE_2FASketch_H_
+
+#include "FiveTupleHeavyPart.h"
+#include <vector>
+
+// Elastic_2FASketch keyed on the whole 13-byte five tuple instead of its
+// first 4 bytes (the source IP), so heavy hitters are reported per flow.
+// bucket_num buckets take bucket_num * FIVE_TUPLE_BUCKET_BYTES of memory.
+template<int bucket_num>
+class FiveTuple_2FASketch
+{
+    FiveTuple_2FA_HeavyPart<bucket_num> heavy_part;
+    int thres_set;
+
+public:
+    FiveTuple_2FASketch(int thres_set): thres_set(thres_set){}
+    ~FiveTuple_2FASketch(){}
+    void clear()
+    {
+        heavy_part.clear();
+    }
+
+    void insert(uint8_t *key, int f = 1)
+    {
+        int res =  heavy_part.quick_insert(key, f, thres_set);
+        if(res == thres_set) {heavy_part.quick_insert(key, f);}
+    }
+
+    // keys: n records of stride bytes, e.g. a FIVE_TUPLE array with stride 13
+    void insert_batch(const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        heavy_part.insert_batch(keys, n, stride, f, thres_set);
+    }
+
+    int query(uint8_t *key)
+    {
+        return heavy_part.query(key, thres_set);
+    }
+
+    // keys of the results are the 13-byte five tuples
+    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, [&](const uint8_t *key, int count) {
+            results.push_back(make_pair(string((const char*)key, KEY_LENGTH_13), count));
+        });
+    }
+
+    // calls visit(key, count) for every heavy hitter, key pointing to the
+    // 13-byte five tuple inside the sketch; nothing is allocated
+    template<typename Visitor>
+    void for_each_heavy_hitter(int threshold, Visitor &&visit)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+/* interface */
+    int get_bucket_num() { return heavy_part.get_bucket_num(); }
+    int get_memory_usage() { return heavy_part.get_memory_usage(); }
+
+    double get_cnt_ratio(){ return heavy_part.cnt / (double) heavy_part.cnt_all;}
+    int get_cnt(){ return heavy_part.cnt_all;}
+
+    void *operator new(size_t sz)
+    {
+        return sketch_alloc(sz);
+    }
+    void operator delete(void *p)
+    {
+        sketch_free(p);
+    }
+};
+
+#endif
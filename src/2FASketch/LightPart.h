@@ -0,0 +1,190 @@
+#ifndef _ELASTIC_2FA_LIGHTPART_H_
+#define _ELASTIC_2FA_LIGHTPART_H_
+
+#include "../common/EMFSD.h"
+#include "param.h"
+
+// 8-bit counters for the packets the heavy part does not keep: the ones the
+// guard turns away and the counters it evicts. It does the same job as
+// elastic/LightPart.h, but is made for the insert path of 2FASketch:
+//  - positions come from a seeded multiplicative hash and a multiply-shift
+//    reduction instead of BOBHash32 and %;
+//  - an insert is one saturating add, and mice_dist is not kept per packet.
+//    The counter histogram is computed when a measurement needs it;
+//  - insert_batch takes the evictions gathered over a batch of heavy part
+//    inserts, hashing and prefetching ahead like Elastic_2FA_HeavyPart.
+struct LightItem
+{
+	uint32_t key;
+	uint32_t val;
+	uint32_t swapped; // evicted from the heavy part: val is its counter, kept as a max
+};
+
+#define LIGHT_BATCH 64
+
+template <int counter_num>
+class Elastic_2FA_LightPart
+{
+	uint32_t multiplier;
+
+public:
+	alignas(64) uint8_t counters[counter_num];
+	uint32_t seed;
+	EMFSD em_fsd_algo;	// kept for its cached combinations and warm starts
+
+	Elastic_2FA_LightPart(uint32_t seed = SKETCH_RANDOM_SEED)
+	{
+		clear();
+		set_seed(seed);
+	}
+
+	void clear()
+	{
+		memset(counters, 0, counter_num);
+	}
+
+	// seed is a BOBHash32 prime index like the heavy part's, the multiplier
+	// is derived from it and always odd
+	void set_seed(uint32_t seed)
+	{
+		this->seed = sketch_seed(seed);
+		multiplier = (uint32_t)(((uint64_t)(this->seed + 1) * 0x9E3779B97F4A7C15ull) >> 32) | 1;
+	}
+
+	/* insertion */
+	void insert(const uint8_t *key, int f = 1)
+	{
+		add(position(*(const uint32_t *)key), f);
+	}
+
+	void swap_insert(const uint8_t *key, int f)
+	{
+		raise(position(*(const uint32_t *)key), f);
+	}
+
+	void insert_batch(const LightItem *items, size_t n)
+	{
+		uint32_t poses[LIGHT_BATCH];
+		for (size_t base = 0; base < n; base += LIGHT_BATCH)
+		{
+			size_t m = n - base < LIGHT_BATCH ? n - base : LIGHT_BATCH;
+			for (size_t i = 0; i < m; ++i)
+			{
+				poses[i] = position(items[base + i].key);
+				_mm_prefetch((const char *)&counters[poses[i]], _MM_HINT_T0);
+			}
+			for (size_t i = 0; i < m; ++i)
+			{
+				if (items[base + i].swapped)
+					raise(poses[i], items[base + i].val);
+				else
+					add(poses[i], items[base + i].val);
+			}
+		}
+	}
+
+	/* query */
+	int query(const uint8_t *key)
+	{
+		return counters[position(*(const uint32_t *)key)];
+	}
+
+	// adds the counters of other, which has the same seed, saturating at 255
+	void merge(const Elastic_2FA_LightPart &other)
+	{
+		int i = 0;
+#ifdef __AVX2__
+		for (; i + 32 <= counter_num; i += 32)
+		{
+			__m256i a = _mm256_load_si256((const __m256i *)&counters[i]);
+			__m256i b = _mm256_load_si256((const __m256i *)&other.counters[i]);
+			_mm256_store_si256((__m256i *)&counters[i], _mm256_adds_epu8(a, b));
+		}
+#endif
+		for (; i < counter_num; ++i)
+		{
+			int val = (int)counters[i] + other.counters[i];
+			counters[i] = (uint8_t)(val < 255 ? val : 255);
+		}
+	}
+
+	/* measurement, from the counter histogram */
+	void get_mice_dist(int mice_dist[256])
+	{
+		memset(mice_dist, 0, sizeof(int) * 256);
+		for (int i = 0; i < counter_num; ++i)
+			mice_dist[counters[i]]++;
+	}
+
+	int get_cardinality()
+	{
+		int mice_dist[256];
+		get_mice_dist(mice_dist);
+		double rate = mice_dist[0] / (double)counter_num;
+		return counter_num * log(1 / rate);
+	}
+
+	void get_entropy(int &tot, double &entr)
+	{
+		int mice_dist[256];
+		get_mice_dist(mice_dist);
+		for (int i = 1; i < 256; i++)
+		{
+			tot += mice_dist[i] * i;
+			entr += mice_dist[i] * i * log2(i);
+		}
+	}
+
+	// warm_start: begin from the previous estimate, see EMFSD::set_counters
+	void get_distribution(vector<double> &dist, bool warm_start = false)
+	{
+		em_fsd_algo.set_counters(counter_num, counters, warm_start);
+		em_fsd_algo.run();
+		dist = em_fsd_algo.ns;
+	}
+
+	int get_memory_usage() { return counter_num; }
+
+private:
+	uint32_t position(uint32_t key)
+	{
+		return (uint32_t)(((uint64_t)(key * multiplier) * counter_num) >> 32);
+	}
+
+	void add(uint32_t pos, uint32_t f)
+	{
+		uint32_t val = counters[pos] + f;
+		counters[pos] = (uint8_t)(val < 255 ? val : 255);
+	}
+
+	void raise(uint32_t pos, uint32_t f)
+	{
+		uint8_t val = (uint8_t)(f < 255 ? f : 255);
+		if (counters[pos] < val)
+			counters[pos] = val;
+	}
+};
+
+// no light part: Elastic_2FASketch<bucket_num> keeps only the heavy part
+template <>
+class Elastic_2FA_LightPart<0>
+{
+public:
+	uint8_t *counters = NULL;
+	uint32_t seed = 0;
+
+	Elastic_2FA_LightPart(uint32_t seed = SKETCH_RANDOM_SEED) {}
+	void clear() {}
+	void set_seed(uint32_t seed) {}
+	void insert(const uint8_t *key, int f = 1) {}
+	void swap_insert(const uint8_t *key, int f) {}
+	void insert_batch(const LightItem *items, size_t n) {}
+	int query(const uint8_t *key) { return 0; }
+	void merge(const Elastic_2FA_LightPart &other) {}
+	int get_cardinality() { return 0; }
+	void get_entropy(int &tot, double &entr) {}
+	void get_distribution(vector<double> &dist, bool warm_start = false) { dist.clear(); }
+	int get_memory_usage() { return 0; }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _SHARDED_2FASketch_H_
+#define _SHARDED_2FASketch_H_
+
+#include "HeavyPart.h"
+#include <vector>
+
+// Flows are partitioned over shard_num independent heavy parts by a hash of
+// the 4-byte key that is independent of the bucket hash. Each shard is owned
+// by one worker, so inserts need no synchronization; queries merge shards.
+template<int bucket_num, int shard_num>
+class Sharded_2FASketch
+{
+    // one shard per worker; the alignment keeps the cnt/cnt_all of
+    // neighbouring shards on different cache lines
+    struct alignas(64) Shard
+    {
+        Elastic_2FA_HeavyPart<bucket_num> heavy_part;
+    };
+
+    Shard shards[shard_num];
+    int thres_set;
+
+public:
+    Sharded_2FASketch(int thres_set): thres_set(thres_set){}
+    ~Sharded_2FASketch(){}
+    void clear()
+    {
+        for (int i = 0; i < shard_num; ++i)
+            shards[i].heavy_part.clear();
+    }
+
+    static int get_shard(const uint8_t *key)
+    {
+        uint32_t fp = *((uint32_t *)key);
+        return CalculateShardPos(fp) % shard_num;
+    }
+
+    // must only be called by the worker owning the shard of key
+    void insert(int shard, uint8_t *key, int f = 1)
+    {
+        int res = shards[shard].heavy_part.quick_insert(key, f, thres_set);
+        if(res == thres_set) {shards[shard].heavy_part.quick_insert(key, f);}
+    }
+
+    void insert(uint8_t *key, int f = 1)
+    {
+        insert(get_shard(key), key, f);
+    }
+
+    // all n records must belong to shard
+    void insert_batch(int shard, const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        shards[shard].heavy_part.insert_batch(keys, n, stride, f, thres_set);
+    }
+
+    int query(uint8_t *key)
+    {
+        return shards[get_shard(key)].heavy_part.query(key, thres_set);
+    }
+
+    // a key is only in its own shard, so shards need no merging
+    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
+    {
+        for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            results.push_back(make_pair(string((const char*)&key, 4), count));
+        });
+    }
+
+    template<typename Visitor>
+    void for_each_heavy_hitter(int threshold, Visitor &&visit)
+    {
+        for (int s = 0; s < shard_num; ++s)
+            shards[s].heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+/* interface */
+    int get_bucket_num() { return bucket_num * shard_num; }
+    int get_shard_num() { return shard_num; }
+
+    double get_cnt_ratio()
+    {
+        int cnt = 0, cnt_all = 0;
+        for (int i = 0; i < shard_num; ++i)
+        {
+            cnt += shards[i].heavy_part.cnt;
+            cnt_all += shards[i].heavy_part.cnt_all;
+        }
+        return cnt / (double) cnt_all;
+    }
+
+    void *operator new(size_t sz)
+    {
+        return sketch_alloc(sz);
+    }
+    void operator delete(void *p)
+    {
+        sketch_free(p);
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef _WINDOWED_2FASketch_H_
+#define _WINDOWED_2FASketch_H_
+
+#include "HeavyPart.h"
+#include <atomic>
+#include <vector>
+
+// Heavy hitters per time window. window_num heavy parts form a ring: inserts
+// go to the current one, and rotate() makes the next one current, which
+// closes the current window without copying or clearing anything. A closed
+// window stays queryable until the ring comes back to it, window_num - 1
+// rotations later, so a reporter thread can drain it while the writer keeps
+// inserting. After draining, the reporter calls release() to clear the window
+// off the hot path. rotate() clears the next window itself only if it was
+// never released.
+//
+// Windows are numbered by epoch, starting at 0. Inserts and rotate() belong
+// to one writer thread. The epoch queries and release() may run on another
+// thread, as long as they target closed windows.
+template<int bucket_num, int window_num = 3>
+class Windowed_2FASketch
+{
+    enum { WINDOW_OPEN, WINDOW_CLOSED, WINDOW_CLEARING, WINDOW_CLEAN };
+
+    // the epoch a window holds and its state share one word, so that a
+    // release() of an epoch the ring has moved past cannot clear a newer one
+    static uint64_t window_tag(uint64_t e, int state) { return e << 2 | state; }
+    static int state_of(uint64_t tag) { return tag & 3; }
+
+    struct alignas(64) Window
+    {
+        Elastic_2FA_HeavyPart<bucket_num> heavy_part;
+        std::atomic<uint64_t> state;   // window_tag(epoch, WINDOW_*)
+    };
+
+    Window windows[window_num];
+    std::atomic<uint64_t> epoch;
+    int cur;
+    int thres_set;
+    uint64_t window_len, window_end;
+    uint64_t sync_clears;
+
+    Window &window_of(uint64_t e) { return windows[e % window_num]; }
+
+    // clear w if it still holds closed epoch e and the other thread is not
+    // already doing so; true if this call cleared it
+    bool try_clear(Window &w, uint64_t e)
+    {
+        uint64_t tag = window_tag(e, WINDOW_CLOSED);
+        if (!w.state.compare_exchange_strong(tag, window_tag(e, WINDOW_CLEARING), std::memory_order_acquire))
+            return false;
+        w.heavy_part.clear();
+        w.state.store(window_tag(e, WINDOW_CLEAN), std::memory_order_release);
+        return true;
+    }
+
+public:
+    static_assert(window_num >= 2, "the ring needs a window to insert into and one to drain");
+
+    // window_len > 0 makes advance() rotate every window_len units of the
+    // caller's clock; 0 leaves rotation to explicit rotate() calls
+    Windowed_2FASketch(int thres_set, uint64_t window_len = 0)
+        : epoch(0), cur(0), thres_set(thres_set), window_len(window_len), window_end(0), sync_clears(0)
+    {
+        windows[0].state.store(window_tag(0, WINDOW_OPEN), std::memory_order_relaxed);
+        for (int i = 1; i < window_num; ++i)
+            windows[i].state.store(window_tag(0, WINDOW_CLEAN), std::memory_order_relaxed);
+    }
+    ~Windowed_2FASketch(){}
+
+    void clear()
+    {
+        for (int i = 0; i < window_num; ++i)
+        {
+            windows[i].heavy_part.clear();
+            windows[i].state.store(window_tag(0, i == 0 ? WINDOW_OPEN : WINDOW_CLEAN), std::memory_order_relaxed);
+        }
+        epoch.store(0, std::memory_order_release);
+        cur = 0;
+        window_end = 0;
+    }
+
+    void insert(uint8_t *key, int f = 1)
+    {
+        Elastic_2FA_HeavyPart<bucket_num> &heavy_part = windows[cur].heavy_part;
+        int res =  heavy_part.quick_insert(key, f, thres_set);
+        if(res == thres_set) {heavy_part.quick_insert(key, f);}
+    }
+
+    void insert_batch(const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        windows[cur].heavy_part.insert_batch(keys, n, stride, f, thres_set);
+    }
+
+    // closes the current window and returns its epoch
+    uint64_t rotate()
+    {
+        uint64_t closed = epoch.load(std::memory_order_relaxed);
+        int next = (cur + 1) % window_num;
+        Window &w = windows[next];
+        uint64_t tag = w.state.load(std::memory_order_acquire);
+        if (state_of(tag) != WINDOW_CLEAN)
+        {
+            // not released yet: clear it here, or wait for the release in progress
+            if (try_clear(w, tag >> 2))
+                sync_clears++;
+            while (state_of(w.state.load(std::memory_order_acquire)) != WINDOW_CLEAN)
+                ;
+        }
+        w.state.store(window_tag(closed + 1, WINDOW_OPEN), std::memory_order_relaxed);
+        windows[cur].state.store(window_tag(closed, WINDOW_CLOSED), std::memory_order_release);
+        cur = next;
+        epoch.store(closed + 1, std::memory_order_release);
+        return closed;
+    }
+
+    // Rotates when now has reached the end of the current window. Windows
+    // are aligned to multiples of window_len. An idle gap spanning several
+    // windows rotates once, so the closed window covers the whole gap.
+    // Returns true if it rotated.
+    bool advance(uint64_t now)
+    {
+        if (window_len == 0)
+            return false;
+        if (window_end == 0)
+            window_end = (now / window_len + 1) * window_len;
+        if (now < window_end)
+            return false;
+        rotate();
+        window_end = (now / window_len + 1) * window_len;
+        return true;
+    }
+
+    /* reporter side: e must be a closed epoch */
+
+    // the epoch inserts currently go to
+    uint64_t current_epoch() const { return epoch.load(std::memory_order_acquire); }
+
+    // true while window e is closed and not reused yet; a reporter that
+    // finds it false after draining e has raced with the ring
+    bool is_readable(uint64_t e) const
+    {
+        uint64_t now = current_epoch();
+        return e < now && now - e < (uint64_t)window_num;
+    }
+
+    int query(uint64_t e, uint8_t *key)
+    {
+        return window_of(e).heavy_part.query(key, thres_set);
+    }
+
+    template<typename Visitor>
+    void for_each_heavy_hitter(uint64_t e, int threshold, Visitor &&visit)
+    {
+        window_of(e).heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+    void get_heavy_hitters(uint64_t e, int threshold, vector<pair<string, int>> & results)
+    {
+        for_each_heavy_hitter(e, threshold, [&](uint32_t key, int count) {
+            results.push_back(make_pair(string((const char*)&key, 4), count));
+        });
+    }
+
+    // see Elastic_2FASketch::get_heavy_hitters
+    size_t get_heavy_hitters(uint64_t e, int threshold, uint32_t *keys, int *counts, size_t capacity)
+    {
+        size_t num = 0;
+        for_each_heavy_hitter(e, threshold, [&](uint32_t key, int count) {
+            if (num < capacity)
+            {
+                keys[num] = key;
+                counts[num] = count;
+            }
+            num++;
+        });
+        return num;
+    }
+
+    // done with window e: clear it now so that rotate() does not have to.
+    // Does nothing if the ring has reused the window since.
+    void release(uint64_t e)
+    {
+        if (is_readable(e))
+            try_clear(window_of(e), e);
+    }
+
+/* interface */
+    int get_bucket_num() { return bucket_num; }
+    int get_memory_usage() { return window_num * windows[0].heavy_part.get_memory_usage(); }
+    // rotations that had to clear an unreleased window on the hot path
+    uint64_t get_sync_clears() { return sync_clears; }
+
+    void *operator new(size_t sz)
+    {
+        return sketch_alloc(sz);
+    }
+    void operator delete(void *p)
+    {
+        sketch_free(p);
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+// Stress and accuracy checks of Concurrent_2FASketch:
+//  - one thread must report the heavy hitters of Elastic_2FASketch;
+//  - a key set that fits the sketch, hammered by many threads, must be
+//    counted exactly;
+//  - on a trace, the heavy hitters and their errors with 2, 4 and 8 threads
+//    must stay close to the single-threaded ones.
+//   g++ -O2 -std=c++14 -mavx2 -pthread -o test_concurrent test_concurrent.cpp
+//   ./test_concurrent ../../data/0.dat
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include "2FASketch.h"
+#include "Concurrent2FASketch.h"
+
+#define BUCKET_NUM 1024
+#define SEED 7
+
+struct FIVE_TUPLE { char key[13]; };
+
+typedef Elastic_2FASketch<BUCKET_NUM> SKETCH;
+typedef Concurrent_2FASketch<BUCKET_NUM> CONCURRENT_SKETCH;
+
+// every thread inserts its contiguous slice of the n records
+static void insert_parallel(CONCURRENT_SKETCH *sketch, const FIVE_TUPLE *trace, size_t n, int thread_num)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t)
+        threads.emplace_back([=] {
+            size_t begin = n * t / thread_num, end = n * (t + 1) / thread_num;
+            sketch->insert_batch((const uint8_t *)(trace + begin), end - begin, sizeof(FIVE_TUPLE));
+        });
+    for (auto &t : threads)
+        t.join();
+}
+
+template<typename Sketch>
+static std::unordered_map<uint32_t, int> heavy_hitters(Sketch *sketch, int threshold)
+{
+    std::unordered_map<uint32_t, int> hh;
+    sketch->for_each_heavy_hitter(threshold, [&](uint32_t key, int count) { hh[key] = count; });
+    return hh;
+}
+
+static double f1_of(const std::unordered_map<uint32_t, int> &reported, const std::unordered_map<uint32_t, int> &truth)
+{
+    int hit = 0;
+    for (auto &kv : reported)
+        hit += truth.count(kv.first);
+    if (hit == 0)
+        return 0;
+    double precision = (double)hit / reported.size(), recall = (double)hit / truth.size();
+    return 2 * precision * recall / (precision + recall);
+}
+
+static double are_of(const std::unordered_map<uint32_t, int> &reported, const std::unordered_map<uint32_t, int> &truth)
+{
+    double are = 0;
+    for (auto &kv : truth)
+    {
+        auto it = reported.find(kv.first);
+        are += std::abs((it == reported.end() ? 0 : it->second) - kv.second) / (double)kv.second;
+    }
+    return truth.empty() ? 0 : are / truth.size();
+}
+
+int main(int argc, char *argv[])
+{
+    int failed = 0;
+
+    // exact counts: 512 keys in 1024 buckets never leave their slot
+    {
+        const int key_num = 512, rounds = 2000, thread_num = 8;
+        std::vector<FIVE_TUPLE> keys(key_num * rounds);
+        for (int r = 0; r < rounds; ++r)
+            for (int k = 0; k < key_num; ++k)
+                *(uint32_t *)keys[r * key_num + k].key = k * 2654435761u + 1;
+        CONCURRENT_SKETCH *sketch = new CONCURRENT_SKETCH(1 << 30, SEED);
+        insert_parallel(sketch, keys.data(), keys.size(), thread_num);
+        for (int k = 0; k < key_num; ++k)
+            if (sketch->query((uint8_t *)keys[k].key) != rounds)
+            {
+                std::cout << "key " << k << ": " << sketch->query((uint8_t *)keys[k].key) << " instead of " << rounds << std::endl;
+                failed++;
+                break;
+            }
+        delete sketch;
+    }
+
+    const char *path = argc > 1 ? argv[1] : "../../data/0.dat";
+    std::ifstream fin(path, std::ios::binary);
+    std::vector<FIVE_TUPLE> trace;
+    FIVE_TUPLE tuple;
+    while (fin.read(tuple.key, sizeof(tuple.key)))
+        trace.push_back(tuple);
+    if (trace.empty())
+    {
+        std::cout << "cannot read " << path << std::endl;
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, int> truth_all;
+    for (auto &t : trace)
+        truth_all[*(uint32_t *)t.key]++;
+    int threshold = trace.size() / 10000;
+    std::unordered_map<uint32_t, int> truth;
+    for (auto &kv : truth_all)
+        if (kv.second >= threshold)
+            truth[kv.first] = kv.second;
+
+    SKETCH *single = new SKETCH(threshold / 2, SEED);
+    single->insert_batch((const uint8_t *)trace.data(), trace.size(), sizeof(FIVE_TUPLE));
+    auto single_hh = heavy_hitters(single, threshold);
+    double single_f1 = f1_of(single_hh, truth), single_are = are_of(single_hh, truth);
+    printf("1 thread (Elastic_2FASketch): F1 %f, ARE %f\n", single_f1, single_are);
+
+    for (int thread_num : {1, 2, 4, 8})
+    {
+        CONCURRENT_SKETCH *sketch = new CONCURRENT_SKETCH(threshold / 2, SEED);
+        insert_parallel(sketch, trace.data(), trace.size(), thread_num);
+        auto hh = heavy_hitters(sketch, threshold);
+        double f1 = f1_of(hh, truth), are = are_of(hh, truth);
+        printf("%d threads: F1 %f, ARE %f, F1 against 1 thread %f\n", thread_num, f1, are, f1_of(hh, single_hh));
+
+        if (thread_num == 1 && hh != single_hh)
+        {
+            std::cout << "1 thread does not match Elastic_2FASketch" << std::endl;
+            failed++;
+        }
+        // threads reorder the stream, which moves small flows around but
+        // must not lose the heavy ones
+        if (f1 < single_f1 - 0.02 || are > single_are + 0.02)
+        {
+            std::cout << thread_num << " threads are less accurate than 1" << std::endl;
+            failed++;
+        }
+        delete sketch;
+    }
+    delete single;
+
+    std::cout << (failed ? "FAILED" : "all concurrent checks passed") << std::endl;
+    return failed != 0;
+}
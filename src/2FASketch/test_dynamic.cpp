@@ -0,0 +1,28 @@
+// Checks that Dynamic_2FASketch rejects a memory size below one bucket and
+// that a one-bucket sketch counts:
+//   g++ -O2 -std=c++14 -mavx2 -o test_dynamic test_dynamic.cpp
+#include <iostream>
+#include "Dynamic2FASketch.h"
+
+int main()
+{
+    int failed = 0;
+
+    try {
+        Dynamic_2FASketch sketch(sizeof(Bucket) - 1, 100);
+        std::cout << "a sketch smaller than one bucket was built" << std::endl;
+        failed++;
+    } catch (const std::invalid_argument &) {}
+
+    Dynamic_2FASketch sketch(sizeof(Bucket), 100);
+    uint32_t key = 42;
+    for (int i = 0; i < 3; ++i)
+        sketch.insert((uint8_t *)&key);
+    if (sketch.query((uint8_t *)&key) != 3) {
+        std::cout << "one-bucket sketch counts " << sketch.query((uint8_t *)&key) << " instead of 3" << std::endl;
+        failed++;
+    }
+
+    std::cout << (failed ? "FAILED" : "all dynamic checks passed") << std::endl;
+    return failed != 0;
+}
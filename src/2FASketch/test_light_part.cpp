@@ -0,0 +1,68 @@
+// Accuracy checks of Elastic_2FASketch with a light part: on a trace, the
+// cardinality and entropy must stay close to the exact ones, and so must
+// those of the batched insert.
+//   g++ -O2 -std=c++14 -mavx2 -o test_light_part test_light_part.cpp
+//   ./test_light_part ../../data/0.dat
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include "2FASketch.h"
+
+#define BUCKET_NUM 8192
+#define LIGHT_MEM (256 * 1024)
+#define SEED 7
+
+struct FIVE_TUPLE { char key[13]; };
+
+typedef Elastic_2FASketch<BUCKET_NUM, LIGHT_MEM> SKETCH;
+
+static int check(const char *name, double est, double truth, double max_err)
+{
+    double err = std::abs(est - truth) / truth;
+    printf("%s: %f against %f true, error %f\n", name, est, truth, err);
+    if (err <= max_err)
+        return 0;
+    std::cout << name << " is off by more than " << max_err << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int failed = 0;
+
+    const char *path = argc > 1 ? argv[1] : "../../data/0.dat";
+    std::ifstream fin(path, std::ios::binary);
+    std::vector<FIVE_TUPLE> trace;
+    FIVE_TUPLE tuple;
+    while (fin.read(tuple.key, sizeof(tuple.key)))
+        trace.push_back(tuple);
+    if (trace.empty())
+    {
+        std::cout << "cannot read " << path << std::endl;
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, int> truth;
+    for (auto &t : trace)
+        truth[*(uint32_t *)t.key]++;
+    double entropy = 0;
+    for (auto &kv : truth)
+        entropy -= kv.second * log2(kv.second);
+    entropy = entropy / trace.size() + log2(trace.size());
+
+    SKETCH *sketch = new SKETCH(trace.size() / 20000, SEED);
+    for (auto &t : trace)
+        sketch->insert((uint8_t *)t.key);
+    failed += check("cardinality", sketch->get_cardinality(), truth.size(), 0.05);
+    failed += check("entropy", sketch->get_entropy(), entropy, 0.02);
+
+    SKETCH *batched = new SKETCH(trace.size() / 20000, SEED);
+    batched->insert_batch((const uint8_t *)trace.data(), trace.size(), sizeof(FIVE_TUPLE));
+    failed += check("batched cardinality", batched->get_cardinality(), truth.size(), 0.05);
+    failed += check("batched entropy", batched->get_entropy(), entropy, 0.02);
+
+    delete sketch;
+    delete batched;
+    std::cout << (failed ? "FAILED" : "all light part checks passed") << std::endl;
+    return failed != 0;
+}
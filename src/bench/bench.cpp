@@ -0,0 +1,386 @@
+#include <getopt.h>
+#include <chrono>
+#include <map>
+
+#include "bench_sketch.h"
+#include "../common/trace_reader.h"
+
+// One process for every algorithm x memory size x trace: the traces are
+// mapped and their exact counts computed once, the sketches are created at
+// runtime from the registry, so no recompile per memory size is needed.
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+// packets per timed chunk of the latency percentiles
+#define LATENCY_CHUNK 1024
+
+// exact counts of the keys made of the first key_len bytes of each record
+struct GroundTruth
+{
+	unordered_map<string, int> real_freq;
+	int real_heavy_hitter_num = 0;
+};
+
+struct Dataset
+{
+	string name;
+	TRACE trace;
+	int threshold;
+	map<int, GroundTruth> truth;	// by key_len, built on first use
+};
+
+struct Result
+{
+	string algo;
+	int memory_kb;
+	string dataset;
+	size_t packets;
+	double throughput;	// Mpps
+	double latency_p50, latency_p99, latency_p999;	// ns per packet, over chunks
+	double precision_rate, recall_rate, F_score, ARE, AAE;
+};
+
+static double percentile(vector<double> &v, double p)
+{
+	if (v.empty())
+		return 0;
+	size_t k = min(v.size() - 1, (size_t)(p * v.size()));
+	nth_element(v.begin(), v.begin() + k, v.end());
+	return v[k];
+}
+
+static const GroundTruth &ground_truth(Dataset &d, int key_len)
+{
+	auto it = d.truth.find(key_len);
+	if (it != d.truth.end())
+		return it->second;
+
+	GroundTruth &t = d.truth[key_len];
+	int packet_cnt = (int)d.trace.size();
+	for (int i = 0; i < packet_cnt; ++i)
+	{
+		string str((const char*)(d.trace[i].key), key_len);
+		t.real_freq[str]++;
+	}
+	for (auto &kv : t.real_freq)
+		if (kv.second >= d.threshold)
+			t.real_heavy_hitter_num++;
+	return t;
+}
+
+static bool load_dataset(Dataset &d, const char *path)
+{
+	d.name = path;
+	if (!d.trace.open(path))
+		return false;
+	d.threshold = HEAVY_HITTER_THRESHOLD((int)d.trace.size());
+	return true;
+}
+
+static void run_one(BenchSketch *sketch, Dataset &d, int key_len, Result &r)
+{
+	typedef chrono::steady_clock clock;
+	const uint8_t *keys = (const uint8_t *)d.trace.data();
+	size_t n = d.trace.size();
+	vector<double> chunk_ns;
+	chunk_ns.reserve(n / LATENCY_CHUNK + 1);
+
+	double total_ns = 0;
+	for (size_t i = 0; i < n; i += LATENCY_CHUNK)
+	{
+		size_t len = min((size_t)LATENCY_CHUNK, n - i);
+		clock::time_point t1 = clock::now();
+		sketch->insert_batch(keys + i * sizeof(FIVE_TUPLE), len, sizeof(FIVE_TUPLE));
+		clock::time_point t2 = clock::now();
+		double ns = chrono::duration<double, nano>(t2 - t1).count();
+		total_ns += ns;
+		chunk_ns.push_back(ns / len);
+	}
+	r.packets = n;
+	r.throughput = total_ns > 0 ? n * 1000.0 / total_ns : 0;
+	r.latency_p50 = percentile(chunk_ns, 0.5);
+	r.latency_p99 = percentile(chunk_ns, 0.99);
+	r.latency_p999 = percentile(chunk_ns, 0.999);
+
+	const GroundTruth &t = ground_truth(d, key_len);
+	vector< pair<string, int> > heavy_hitters;
+	sketch->get_heavy_hitters(d.threshold, heavy_hitters);
+	double correct = 0, ARE = 0, AAE = 0;
+	for (auto &hh : heavy_hitters)
+	{
+		auto it = t.real_freq.find(hh.first);
+		int real = it == t.real_freq.end() ? 0 : it->second;
+		if (real >= d.threshold)
+			correct++;
+		if (real > 0)
+			ARE += abs(hh.second - real) / (double)real;
+		AAE += abs(hh.second - real);
+	}
+	size_t reported = heavy_hitters.size();
+	r.precision_rate = reported ? correct / reported : 0;
+	r.recall_rate = t.real_heavy_hitter_num ? correct / t.real_heavy_hitter_num : 0;
+	r.F_score = r.precision_rate + r.recall_rate > 0 ?
+		2 * r.precision_rate * r.recall_rate / (r.precision_rate + r.recall_rate) : 0;
+	r.ARE = reported ? ARE / reported : 0;
+	r.AAE = reported ? AAE / reported : 0;
+}
+
+// per-insert cycles of a fresh sketch, apart from run_one so the rdtsc reads
+// do not weigh on its throughput
+static void run_latency(BenchSketch *sketch, Dataset &d, LatencyHist *hists)
+{
+	sketch->insert_latency((const uint8_t *)d.trace.data(), d.trace.size(), sizeof(FIVE_TUPLE), hists);
+}
+
+static void write_latency(FILE *out, const char *algo, int memory_kb, const string &dataset, const LatencyHist *hists)
+{
+	uint64_t all = hists[LATENCY_ALL].count();
+	for (int o = 0; o <= LATENCY_ALL; ++o)
+	{
+		const LatencyHist &h = hists[o];
+		if (h.count() == 0)
+			continue;
+		fprintf(out, "%s,%d,%s,%s,%lu,%f,%lu,%lu,%lu,%lu\n", algo, memory_kb, dataset.c_str(),
+				o == LATENCY_ALL ? "all" : insert_outcome_name[o], (unsigned long)h.count(),
+				(double)h.count() / all, (unsigned long)h.percentile(0.5), (unsigned long)h.percentile(0.99),
+				(unsigned long)h.percentile(0.999), (unsigned long)h.max());
+	}
+}
+
+static void write_results(FILE *out, const vector<Result> &results, bool json)
+{
+	if (json)
+		fprintf(out, "[\n");
+	else
+		fprintf(out, "algorithm,memory_kb,dataset,packets,throughput_mpps,latency_p50_ns,latency_p99_ns,latency_p999_ns,"
+				"precision,recall,f1,are,aae\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		if (json)
+			fprintf(out, "  {\"algorithm\": \"%s\", \"memory_kb\": %d, \"dataset\": \"%s\", \"packets\": %zu, "
+					"\"throughput_mpps\": %f, \"latency_p50_ns\": %f, \"latency_p99_ns\": %f, \"latency_p999_ns\": %f, "
+					"\"precision\": %f, \"recall\": %f, \"f1\": %f, \"are\": %f, \"aae\": %f}%s\n",
+					r.algo.c_str(), r.memory_kb, r.dataset.c_str(), r.packets,
+					r.throughput, r.latency_p50, r.latency_p99, r.latency_p999,
+					r.precision_rate, r.recall_rate, r.F_score, r.ARE, r.AAE,
+					i + 1 < results.size() ? "," : "");
+		else
+			fprintf(out, "%s,%d,%s,%zu,%f,%f,%f,%f,%f,%f,%f,%f,%f\n",
+					r.algo.c_str(), r.memory_kb, r.dataset.c_str(), r.packets,
+					r.throughput, r.latency_p50, r.latency_p99, r.latency_p999,
+					r.precision_rate, r.recall_rate, r.F_score, r.ARE, r.AAE);
+	}
+	if (json)
+		fprintf(out, "]\n");
+}
+
+// mean over the datasets, reported as dataset "avg"
+static Result average(const vector<Result> &results, size_t from)
+{
+	Result avg = results[from];
+	avg.dataset = "avg";
+	size_t cnt = results.size() - from;
+	avg.packets = 0;
+	avg.throughput = avg.latency_p50 = avg.latency_p99 = avg.latency_p999 = 0;
+	avg.precision_rate = avg.recall_rate = avg.F_score = avg.ARE = avg.AAE = 0;
+	for (size_t i = from; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		avg.packets += r.packets;
+		avg.throughput += r.throughput / cnt;
+		avg.latency_p50 += r.latency_p50 / cnt;
+		avg.latency_p99 += r.latency_p99 / cnt;
+		avg.latency_p999 += r.latency_p999 / cnt;
+		avg.precision_rate += r.precision_rate / cnt;
+		avg.recall_rate += r.recall_rate / cnt;
+		avg.F_score += r.F_score / cnt;
+		avg.ARE += r.ARE / cnt;
+		avg.AAE += r.AAE / cnt;
+	}
+	return avg;
+}
+
+static vector<string> split(const char *s)
+{
+	vector<string> ret;
+	stringstream ss(s);
+	string item;
+	while (getline(ss, item, ','))
+		if (!item.empty())
+			ret.push_back(item);
+	return ret;
+}
+
+static void usage(const char *prog, const vector<BenchAlgo> &algos)
+{
+	fprintf(stderr, "usage: %s [-a algo,...] [-m KB,...] [-f csv|json] [-o out_file] [-l latency_file] [trace.dat ...]\n", prog);
+	fprintf(stderr, "  -a  algorithms, default all:");
+	for (auto &a : algos)
+		fprintf(stderr, " %s", a.name);
+	fprintf(stderr, "\n  -m  memory sizes in KB, default 100\n");
+	fprintf(stderr, "  -f  output format, default csv\n");
+	fprintf(stderr, "  -o  output file, default stdout\n");
+	fprintf(stderr, "  -l  also time every insert with rdtsc on a second sketch and write\n"
+					"      p50/p99/p99.9 cycles per insert outcome as csv to latency_file\n");
+	fprintf(stderr, "  traces default to ../../data/0.dat .. 9.dat\n");
+}
+
+int main(int argc, char *argv[])
+{
+	vector<BenchAlgo> algos;
+	register_elastic(algos);
+	register_1FA(algos);
+	register_2FASketch(algos);
+	register_2FASketch_single(algos);
+	register_chainsketch(algos);
+	register_cmheap(algos);
+	register_countheap(algos);
+	register_spacesaving(algos);
+
+	vector<string> algo_names;
+	vector<int> memory_kbs;
+	bool json = false;
+	const char *out_file = NULL;
+	const char *latency_file = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "a:m:f:o:l:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a':
+			algo_names = split(optarg);
+			break;
+		case 'm':
+			for (auto &s : split(optarg))
+				memory_kbs.push_back(atoi(s.c_str()));
+			break;
+		case 'f':
+			json = strcmp(optarg, "json") == 0;
+			break;
+		case 'o':
+			out_file = optarg;
+			break;
+		case 'l':
+			latency_file = optarg;
+			break;
+		default:
+			usage(argv[0], algos);
+			return 1;
+		}
+	}
+	if (memory_kbs.empty())
+		memory_kbs.push_back(100);
+
+	vector<BenchAlgo> selected;
+	if (algo_names.empty())
+		selected = algos;
+	for (auto &name : algo_names)
+	{
+		auto it = find_if(algos.begin(), algos.end(), [&](const BenchAlgo &a) { return name == a.name; });
+		if (it == algos.end())
+		{
+			fprintf(stderr, "unknown algorithm %s\n", name.c_str());
+			usage(argv[0], algos);
+			return 1;
+		}
+		selected.push_back(*it);
+	}
+
+	vector<string> paths;
+	for (int i = optind; i < argc; ++i)
+		paths.push_back(argv[i]);
+	if (paths.empty())
+		for (int i = 0; i < 10; ++i)
+			paths.push_back("../../data/" + to_string(i) + ".dat");
+
+	vector<unique_ptr<Dataset>> datasets;
+	for (auto &path : paths)
+	{
+		datasets.emplace_back(new Dataset());
+		if (!load_dataset(*datasets.back(), path.c_str()))
+		{
+			fprintf(stderr, "cannot open %s\n", path.c_str());
+			return 1;
+		}
+		fprintf(stderr, "Successfully read in %s, %ld packets, %ld flows\n", path.c_str(),
+				datasets.back()->trace.size(), ground_truth(*datasets.back(), 4).real_freq.size());
+	}
+
+	// results go to stdout only; whatever the sketches print goes to stderr
+	FILE *out = out_file ? fopen(out_file, "w") : fdopen(dup(STDOUT_FILENO), "w");
+	if (!out)
+	{
+		fprintf(stderr, "cannot open %s\n", out_file);
+		return 1;
+	}
+	FILE *latency_out = NULL;
+	if (latency_file)
+	{
+		if (!(latency_out = fopen(latency_file, "w")))
+		{
+			fprintf(stderr, "cannot open %s\n", latency_file);
+			return 1;
+		}
+		fprintf(latency_out, "algorithm,memory_kb,dataset,outcome,count,share,p50_cycles,p99_cycles,p999_cycles,max_cycles\n");
+	}
+	fflush(stdout);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	vector<Result> results;
+	for (int memory_kb : memory_kbs)
+		for (auto &algo : selected)
+		{
+			size_t from = results.size();
+			LatencyHist merged[LATENCY_ALL + 1];
+			for (auto &d : datasets)
+			{
+				BenchSketch *sketch = algo.create(memory_kb, d->threshold * 0.5);
+				if (!sketch)
+				{
+					fprintf(stderr, "%s: %dKB is not one of the compiled sizes, skipped\n", algo.name, memory_kb);
+					break;
+				}
+				Result r;
+				r.algo = algo.name;
+				r.memory_kb = memory_kb;
+				r.dataset = d->name;
+				run_one(sketch, *d, algo.key_len, r);
+				delete sketch;
+				results.push_back(r);
+
+				if (latency_out)
+				{
+					LatencyHist hists[LATENCY_ALL + 1];
+					sketch = algo.create(memory_kb, d->threshold * 0.5);
+					run_latency(sketch, *d, hists);
+					delete sketch;
+					write_latency(latency_out, algo.name, memory_kb, d->name, hists);
+					for (int o = 0; o <= LATENCY_ALL; ++o)
+						merged[o].merge(hists[o]);
+				}
+			}
+			if (latency_out && merged[LATENCY_ALL].count())
+			{
+				write_latency(latency_out, algo.name, memory_kb, "all", merged);
+				fprintf(stderr, "%s %dKB: insert p50 %lu, p99 %lu, p99.9 %lu cycles\n", algo.name, memory_kb,
+						(unsigned long)merged[LATENCY_ALL].percentile(0.5), (unsigned long)merged[LATENCY_ALL].percentile(0.99),
+						(unsigned long)merged[LATENCY_ALL].percentile(0.999));
+			}
+			if (results.size() > from)
+			{
+				results.push_back(average(results, from));
+				const Result &avg = results.back();
+				fprintf(stderr, "%s %dKB: %.2f Mpps, F1 %f, ARE %f\n", algo.name, memory_kb,
+						avg.throughput, avg.F_score, avg.ARE);
+			}
+		}
+
+	write_results(out, results, json);
+	fclose(out);
+	if (latency_out)
+		fclose(latency_out);
+	return 0;
+}
@@ -0,0 +1,27 @@
+#include "bench_sketch.h"
+
+namespace bench_1FA
+{
+#include "../1FA/1FA.h"
+}
+using bench_1FA::Elastic_1FA;
+
+template<int memory_kb>
+struct Make1FA
+{
+	static BenchSketch *create(int)
+	{
+		typedef Elastic_1FA<memory_kb * 1024 / 64> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_1FA(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make1FA, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_1FA(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"1FA", create_1FA});
+}
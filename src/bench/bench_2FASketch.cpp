@@ -0,0 +1,107 @@
+#include "bench_sketch.h"
+
+namespace bench_2FASketch
+{
+#include "../2FASketch/2FASketch.h"
+#include "../2FASketch/Dynamic2FASketch.h"
+#include "../2FASketch/FiveTuple2FASketch.h"
+#include "../2FASketch/Compact2FASketch.h"
+}
+using bench_2FASketch::Elastic_2FASketch;
+using bench_2FASketch::Dynamic_2FASketch;
+using bench_2FASketch::FiveTuple_2FASketch;
+using bench_2FASketch::Compact_2FASketch;
+using bench_2FASketch::CompactBucket;
+using bench_2FASketch::Bucket;
+
+template<int memory_kb>
+struct Make2FASketch
+{
+	static BenchSketch *create(int thres_set)
+	{
+		typedef Elastic_2FASketch<memory_kb * 1024 / sizeof(Bucket)> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(thres_set), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_2FASketch(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make2FASketch, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+// three quarters of memory_kb in buckets, the rest in light part counters
+template<int memory_kb>
+struct Make2FASketchLight
+{
+	static BenchSketch *create(int thres_set)
+	{
+		static constexpr int bucket_num = memory_kb * 1024 * 3 / 4 / sizeof(Bucket);
+		typedef Elastic_2FASketch<bucket_num, memory_kb * 1024 - bucket_num * sizeof(Bucket)> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(thres_set), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_2FASketch_light(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make2FASketchLight, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+// runtime-sized, any memory size
+static BenchSketch *create_2FASketch_dynamic(int memory_kb, int thres_set)
+{
+	Dynamic_2FASketch *sketch = new Dynamic_2FASketch((size_t)memory_kb * 1024, thres_set);
+	return new SketchAdapter<Dynamic_2FASketch>(sketch, sketch->get_memory_usage());
+}
+
+// memory_kb covers the buckets and the five tuples stored with them
+template<int memory_kb>
+struct Make2FASketch5Tuple
+{
+	static BenchSketch *create(int thres_set)
+	{
+		typedef FiveTuple_2FASketch<memory_kb * 1024 / FIVE_TUPLE_BUCKET_BYTES> Sketch;
+		Sketch *sketch = new Sketch(thres_set);
+		return new SketchAdapter<Sketch>(sketch, sketch->get_memory_usage());
+	}
+};
+
+static BenchSketch *create_2FASketch_5tuple(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make2FASketch5Tuple, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+// largest power of two <= n
+static constexpr int floor_pow2(int n)
+{
+	return n < 2 ? 1 : 2 * floor_pow2(n / 2);
+}
+
+// 16-bit buckets in half of memory_kb, the overflow table in the other
+// half, up to the entries a slot can point to. Keys are promoted at the
+// heavy hitter threshold (twice thres_set), so all the reportable ones have
+// their key in the table.
+template<int memory_kb>
+struct Make2FASketchCompact
+{
+	static BenchSketch *create(int thres_set)
+	{
+		static constexpr int overflow_num = floor_pow2(std::min(memory_kb * 1024 / 2 / 8, COMPACT_PROMOTED_BIT));
+		typedef Compact_2FASketch<(memory_kb * 1024 - overflow_num * 8) / sizeof(CompactBucket), overflow_num> Sketch;
+		Sketch *sketch = new Sketch(thres_set, 2 * thres_set);
+		return new SketchAdapter<Sketch>(sketch, sketch->get_memory_usage());
+	}
+};
+
+static BenchSketch *create_2FASketch_compact(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make2FASketchCompact, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_2FASketch(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"2FASketch", create_2FASketch});
+	algos.push_back(BenchAlgo{"2FASketch_dynamic", create_2FASketch_dynamic});
+	algos.push_back(BenchAlgo{"2FASketch_5tuple", create_2FASketch_5tuple, KEY_LENGTH_13});
+	algos.push_back(BenchAlgo{"2FASketch_compact", create_2FASketch_compact});
+	algos.push_back(BenchAlgo{"2FASketch_light", create_2FASketch_light});
+}
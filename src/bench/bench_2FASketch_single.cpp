@@ -0,0 +1,41 @@
+#include "bench_sketch.h"
+
+// 2FASketch with the backup bucket derived from the fingerprint; its own
+// namespace, so it links next to the BOBHash32 one of bench_2FASketch.cpp
+namespace bench_2FASketch_single
+{
+#define BACKUP_SINGLE_HASH
+#include "../2FASketch/2FASketch.h"
+#include "../2FASketch/Dynamic2FASketch.h"
+#undef BACKUP_SINGLE_HASH
+}
+using bench_2FASketch_single::Elastic_2FASketch;
+using bench_2FASketch_single::Dynamic_2FASketch;
+using bench_2FASketch_single::Bucket;
+
+template<int memory_kb>
+struct Make2FASketchSingle
+{
+	static BenchSketch *create(int thres_set)
+	{
+		typedef Elastic_2FASketch<memory_kb * 1024 / sizeof(Bucket)> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(thres_set), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_2FASketch_single(int memory_kb, int thres_set)
+{
+	return create_fixed_size<Make2FASketchSingle, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+static BenchSketch *create_2FASketch_dynamic_single(int memory_kb, int thres_set)
+{
+	Dynamic_2FASketch *sketch = new Dynamic_2FASketch((size_t)memory_kb * 1024, thres_set);
+	return new SketchAdapter<Dynamic_2FASketch>(sketch, sketch->get_memory_usage());
+}
+
+void register_2FASketch_single(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"2FASketch_single", create_2FASketch_single});
+	algos.push_back(BenchAlgo{"2FASketch_dynamic_single", create_2FASketch_dynamic_single});
+}
@@ -0,0 +1,45 @@
+#include "bench_sketch.h"
+
+namespace bench_chainsketch
+{
+#include "../chainsketch/chainsketch.h"
+}
+using bench_chainsketch::ChainSketch;
+using bench_chainsketch::KMRowHash;
+
+template<int memory_kb>
+struct MakeChainSketch
+{
+	static BenchSketch *create(int)
+	{
+		typedef ChainSketch<memory_kb * 1024> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(), memory_kb * 1024);
+	}
+};
+
+// the four rows from one 64-bit hash
+template<int memory_kb>
+struct MakeChainSketchKM
+{
+	static BenchSketch *create(int)
+	{
+		typedef ChainSketch<memory_kb * 1024, KMRowHash> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_chainsketch(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeChainSketch, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+static BenchSketch *create_chainsketch_km(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeChainSketchKM, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_chainsketch(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"chainsketch", create_chainsketch});
+	algos.push_back(BenchAlgo{"chainsketch_km", create_chainsketch_km});
+}
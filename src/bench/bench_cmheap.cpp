@@ -0,0 +1,46 @@
+#include "bench_sketch.h"
+
+namespace bench_cmheap
+{
+#include "../CMHeap/CMHeap.h"
+}
+using bench_cmheap::CMHeap;
+using bench_cmheap::BobRowHash;
+using bench_cmheap::KMRowHash;
+
+// 1/4 of the memory for the heap, as in demo/cmheap.cpp
+template<int memory_kb, typename RowHash>
+static BenchSketch *make_cmheap()
+{
+	typedef CMHeap<4, memory_kb / 4 * 1024 / 64, 3, RowHash> Sketch;
+	return new SketchAdapter<Sketch, uint32_t>(new Sketch(memory_kb / 4 * 1024 * 3), memory_kb * 1024);
+}
+
+template<int memory_kb>
+struct MakeCMHeap
+{
+	static BenchSketch *create(int) { return make_cmheap<memory_kb, BobRowHash>(); }
+};
+
+// the three rows from one 64-bit hash
+template<int memory_kb>
+struct MakeCMHeapKM
+{
+	static BenchSketch *create(int) { return make_cmheap<memory_kb, KMRowHash>(); }
+};
+
+static BenchSketch *create_cmheap(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeCMHeap, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+static BenchSketch *create_cmheap_km(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeCMHeapKM, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_cmheap(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"cmheap", create_cmheap});
+	algos.push_back(BenchAlgo{"cmheap_km", create_cmheap_km});
+}
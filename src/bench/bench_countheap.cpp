@@ -0,0 +1,46 @@
+#include "bench_sketch.h"
+
+namespace bench_countheap
+{
+#include "../CountHeap/CountHeap.h"
+}
+using bench_countheap::CountHeap;
+using bench_countheap::BobRowHash;
+using bench_countheap::KMRowHash;
+
+// 1/4 of the memory for the heap, as in demo/countheap.cpp
+template<int memory_kb, typename RowHash>
+static BenchSketch *make_countheap()
+{
+	typedef CountHeap<4, memory_kb / 4 * 1024 / 64, 3, RowHash> Sketch;
+	return new SketchAdapter<Sketch, uint32_t>(new Sketch(3 * memory_kb / 4 * 1024), memory_kb * 1024);
+}
+
+template<int memory_kb>
+struct MakeCountHeap
+{
+	static BenchSketch *create(int) { return make_countheap<memory_kb, BobRowHash>(); }
+};
+
+// the three columns and signs from one 64-bit hash
+template<int memory_kb>
+struct MakeCountHeapKM
+{
+	static BenchSketch *create(int) { return make_countheap<memory_kb, KMRowHash>(); }
+};
+
+static BenchSketch *create_countheap(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeCountHeap, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+static BenchSketch *create_countheap_km(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeCountHeapKM, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_countheap(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"countheap", create_countheap});
+	algos.push_back(BenchAlgo{"countheap_km", create_countheap_km});
+}
@@ -0,0 +1,28 @@
+#include "bench_sketch.h"
+
+namespace bench_elastic
+{
+#include "../elastic/ElasticSketch.h"
+}
+using bench_elastic::ElasticSketch;
+
+// 3/4 of the memory for the heavy part, as in demo/elastic.cpp
+template<int memory_kb>
+struct MakeElastic
+{
+	static BenchSketch *create(int)
+	{
+		typedef ElasticSketch<memory_kb * 3 / 4 * 1024 / 64, memory_kb * 1024> Sketch;
+		return new SketchAdapter<Sketch>(new Sketch(), memory_kb * 1024);
+	}
+};
+
+static BenchSketch *create_elastic(int memory_kb, int thres_set)
+{
+	return create_fixed_size<MakeElastic, BENCH_FIXED_MEMORY_KB>(memory_kb, thres_set);
+}
+
+void register_elastic(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"elastic", create_elastic});
+}
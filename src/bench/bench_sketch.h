@@ -0,0 +1,181 @@
+#ifndef _BENCH_SKETCH_H_
+#define _BENCH_SKETCH_H_
+
+// Every system header the sketch headers pull in. The adapters include a
+// sketch header inside a namespace of its own (Elastic, 1FA and 2FASketch all
+// define Bucket and HeavyPart<bucket_num>), so these must already be included
+// outside of it.
+#include <x86intrin.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <thread>
+
+// shared by the adapters and the heavy parts, which record insert outcomes
+#include "../common/latency_hist.h"
+
+using namespace std;
+
+// index of the histogram of all inserts, after the per-outcome ones
+#define LATENCY_ALL INSERT_OUTCOME_NUM
+
+// Common interface of the sketches driven by bench.out
+class BenchSketch
+{
+public:
+	virtual ~BenchSketch(){}
+	// n keys stride bytes apart, i.e. the records of a trace; one virtual
+	// call per batch so the per-key insert still inlines
+	virtual void insert_batch(const uint8_t *keys, size_t n, size_t stride) = 0;
+	// -1 if the algorithm has no point query
+	virtual int query(const uint8_t *key) = 0;
+	virtual void get_heavy_hitters(int threshold, vector<pair<string, int>> &results) = 0;
+	virtual size_t get_memory_usage() = 0;
+	// inserts one key at a time, recording the rdtsc cycles of each into
+	// hists[LATENCY_ALL] and hists[outcome]; outcomes other than
+	// INSERT_OTHER need a -DLATENCY_HIST build
+	virtual void insert_latency(const uint8_t *keys, size_t n, size_t stride, LatencyHist *hists) = 0;
+};
+
+// thres_set is the replacement threshold of 2FASketch, the other algorithms
+// ignore it. Returns NULL if memory_kb is not supported by the algorithm.
+typedef BenchSketch *(*bench_create_t)(int memory_kb, int thres_set);
+
+struct BenchAlgo
+{
+	const char *name;
+	bench_create_t create;
+	// bytes of each record the heavy hitters are keyed on: the source IP,
+	// or KEY_LENGTH_13 for the whole five tuple
+	int key_len = 4;
+};
+
+// one per bench_<algorithm>.cpp
+void register_elastic(vector<BenchAlgo> &algos);
+void register_1FA(vector<BenchAlgo> &algos);
+void register_2FASketch(vector<BenchAlgo> &algos);
+void register_2FASketch_single(vector<BenchAlgo> &algos);
+void register_chainsketch(vector<BenchAlgo> &algos);
+void register_cmheap(vector<BenchAlgo> &algos);
+void register_countheap(vector<BenchAlgo> &algos);
+void register_spacesaving(vector<BenchAlgo> &algos);
+
+// Memory sizes (KB) compiled into the sketches whose size is a template
+// parameter. Sketches sized at runtime take any size.
+#define BENCH_FIXED_MEMORY_KB 16, 32, 64, 100, 128, 200, 256, 300, 400, 500, 512, 1024
+
+// Make<kb>::create(thres_set) for the kb in kbs equal to memory_kb
+template<template<int> class Make, int... kbs>
+BenchSketch *create_fixed_size(int memory_kb, int thres_set)
+{
+	BenchSketch *ret = NULL;
+	int expand[] = {0, (memory_kb == kbs ? (ret = Make<kbs>::create(thres_set), 0) : 0)...};
+	(void)expand;
+	return ret;
+}
+
+// use insert_batch when the sketch has one
+template<typename S>
+auto bench_insert_batch(S &s, const uint8_t *keys, size_t n, size_t stride, int)
+	-> decltype(s.insert_batch(keys, n, stride), void())
+{
+	s.insert_batch(keys, n, stride);
+}
+
+template<typename S>
+void bench_insert_batch(S &s, const uint8_t *keys, size_t n, size_t stride, long)
+{
+	for (size_t i = 0; i < n; ++i)
+		s.insert((uint8_t *)(keys + i * stride));
+}
+
+template<typename S>
+auto bench_query(S &s, uint8_t *key, int) -> decltype((int)s.query(key))
+{
+	return s.query(key);
+}
+
+template<typename S>
+int bench_query(S &, uint8_t *, long)
+{
+	return -1;
+}
+
+// Count is the counter type of the sketch's get_heavy_hitters results
+template<typename S, typename Count = int>
+class SketchAdapter : public BenchSketch
+{
+	S *sketch;
+	size_t mem_in_bytes;
+
+	SketchAdapter(const SketchAdapter &);
+	SketchAdapter &operator=(const SketchAdapter &);
+
+public:
+	SketchAdapter(S *sketch_, size_t mem_in_bytes_) : sketch(sketch_), mem_in_bytes(mem_in_bytes_) {}
+	~SketchAdapter() { delete sketch; }
+
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride)
+	{
+		bench_insert_batch(*sketch, keys, n, stride, 0);
+	}
+
+	int query(const uint8_t *key)
+	{
+		return bench_query(*sketch, (uint8_t *)key, 0);
+	}
+
+	void get_heavy_hitters(int threshold, vector<pair<string, int>> &results)
+	{
+		vector<pair<string, Count>> heavy_hitters;
+		sketch->get_heavy_hitters(threshold, heavy_hitters);
+		results.clear();
+		for (auto &kv : heavy_hitters)
+			results.push_back(make_pair(kv.first, (int)kv.second));
+	}
+
+	size_t get_memory_usage() { return mem_in_bytes; }
+
+	void insert_latency(const uint8_t *keys, size_t n, size_t stride, LatencyHist *hists)
+	{
+		insert_outcome_mask() = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			uint64_t t1 = rdtsc_begin();
+			sketch->insert((uint8_t *)(keys + i * stride));
+			uint64_t t2 = rdtsc_end();
+			hists[take_insert_outcome()].record(t2 - t1);
+			hists[LATENCY_ALL].record(t2 - t1);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,19 @@
+#include "bench_sketch.h"
+
+namespace bench_spacesaving
+{
+#include "../SpaceSaving/SpaceSaving.h"
+}
+using bench_spacesaving::SpaceSaving;
+
+// runtime-sized, any memory size
+static BenchSketch *create_spacesaving(int memory_kb, int)
+{
+	typedef SpaceSaving<4> Sketch;
+	return new SketchAdapter<Sketch, uint32_t>(new Sketch(memory_kb * 1024), memory_kb * 1024);
+}
+
+void register_spacesaving(vector<BenchAlgo> &algos)
+{
+	algos.push_back(BenchAlgo{"spacesaving", create_spacesaving});
+}
@@ -6,9 +6,15 @@
 #include <cmath>
 #include <unordered_map>
 #include <iostream>
+#include <thread>
 
 using std::vector;
 
+// Flow size distribution from a counter array, by expectation maximisation
+// (MRAC). Every counter value i is explained by the ways a few flows can sum
+// to i; the ways of each value are enumerated once and kept across epochs and
+// across set_counters calls, and the expectation step over the values is
+// split between threads. run() iterates until the estimate stops moving.
 class EMFSD
 {
     uint32_t w;
@@ -21,6 +27,7 @@ public:
     bool inited = false;
 private:
     double n_old, n_new;
+    int thread_num = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
 
     struct BetaGenerator
     {
@@ -104,34 +111,64 @@ private:
         }
     };
 
-    static constexpr int factorial(int n) {
-        if (n == 0 || n == 1)
-            return 1;
-        return factorial(n - 1) * n;
+    // one way to form a counter value: part_num distinct flow sizes, each
+    // taken mult times
+    struct Part
+    {
+        uint32_t size, mult;
+    };
+    struct Comb
+    {
+        uint32_t first_part, part_num;
+        double inv_fact;    // 1 / prod(mult!)
+    };
+    // combs[i]: the ways to form value i, their parts in parts[i]
+    vector<vector<Comb>> combs;
+    vector<vector<Part>> parts;
+
+    static double factorial(int n)
+    {
+        double r = 1;
+        for (int i = 2; i <= n; ++i)
+            r *= i;
+        return r;
     }
 
-    double get_p_from_beta(BetaGenerator & bt, double lambda, vector<double> & now_dist, double now_n)
+    void cache_combs(uint32_t i)
     {
-        std::unordered_map<uint32_t, uint32_t> mp;
-        for (int i = 0; i < bt.now_flow_num; ++i) {
-            mp[bt.now_result[i]]++;
+        if (i < combs.size() && !combs[i].empty())
+            return;
+        if (i >= combs.size()) {
+            combs.resize(i + 1);
+            parts.resize(i + 1);
         }
-
-        double ret = std::exp(-lambda);
-        for (auto & kv: mp) {
-            uint32_t fi = kv.second;
-            uint32_t si = kv.first;
-            double lambda_i = now_n * (now_dist[si]) / w;
-            ret *= (std::pow(lambda_i, fi)) / factorial(fi);
+        BetaGenerator bt(i);
+        while (bt.get_next()) {
+            // now_result is sorted, equal sizes are adjacent
+            Comb c;
+            c.first_part = parts[i].size();
+            c.part_num = 0;
+            c.inv_fact = 1;
+            for (int j = 0; j < bt.now_flow_num; ++j) {
+                uint32_t si = bt.now_result[j];
+                if (c.part_num && parts[i].back().size == si) {
+                    parts[i].back().mult++;
+                } else {
+                    parts[i].push_back(Part{si, 1});
+                    c.part_num++;
+                }
+            }
+            for (uint32_t k = c.first_part; k < c.first_part + c.part_num; ++k)
+                c.inv_fact /= factorial(parts[i][k].mult);
+            combs[i].push_back(c);
         }
-
-        return ret;
     }
 
-    int collect_counters(uint32_t * counters)
+    template<typename T>
+    int collect_counters(const T * counters)
     {
         // collect counter information as the dist init
-        uint32_t max_counter_val = 0;
+        T max_counter_val = 0;
         for (uint32_t i = 0; i < w; ++i) {
             max_counter_val = std::max(max_counter_val, counters[i]);
         }
@@ -140,74 +177,90 @@ private:
         for (uint32_t i = 0; i < w; ++i) {
             counter_dist[counters[i]]++;
         }
-/*
-        std::cout << w << endl;
-        std::cout << counter_dist[0] << endl;
-        std::cout << max_counter_val << endl;
-*/
         return max_counter_val;
     }
 
-    int collect_counters(uint16_t * counters)
+    // expectation step for the values i = first, first + step, ... below
+    // counter_dist.size(), adding the expected flows to out
+    void expect(uint32_t first, uint32_t step, const vector<double> &lambda_i, double lambda, vector<double> &out)
     {
-        // collect counter information as the dist init
-        uint16_t max_counter_val = 0;
-        for (uint32_t i = 0; i < w; ++i) {
-            max_counter_val = std::max(max_counter_val, counters[i]);
-        }
-        counter_dist.resize(max_counter_val + 1);
-        std::fill(counter_dist.begin(), counter_dist.end(), 0);
-        for (uint32_t i = 0; i < w; ++i) {
-            counter_dist[counters[i]]++;
+        vector<double> p;
+        for (uint32_t i = first; i < counter_dist.size(); i += step) {
+            // enum how to form val:i
+            if (counter_dist[i] == 0) {
+                continue;
+            }
+            const vector<Comb> &cs = combs[i];
+            const Part *ps = parts[i].data();
+            p.resize(cs.size());
+            double sum_p = 0;
+            for (size_t c = 0; c < cs.size(); ++c) {
+                double q = std::exp(-lambda) * cs[c].inv_fact;
+                for (uint32_t k = cs[c].first_part; k < cs[c].first_part + cs[c].part_num; ++k)
+                    q *= std::pow(lambda_i[ps[k].size], ps[k].mult);
+                p[c] = q;
+                sum_p += q;
+            }
+            if (sum_p == 0) {
+                continue;
+            }
+            for (size_t c = 0; c < cs.size(); ++c) {
+                double flows = counter_dist[i] * p[c] / sum_p;
+                for (uint32_t k = cs[c].first_part; k < cs[c].first_part + cs[c].part_num; ++k)
+                    out[ps[k].size] += flows * ps[k].mult;
+            }
         }
-        std::cout << w << endl;
-        std::cout << counter_dist[0] << endl;
-        std::cout << max_counter_val << endl;
-
-        return max_counter_val;
     }
 
 public:
-    EMFSD()
-    {
-//        BetaGenerator a(15);
-//        while (a.get_next()) {
-//            for (int j = 0; j < a.now_flow_num; ++j) {
-//                cout << a.now_result[j] << " ";
-//            }
-//            cout << endl;
-//        }
-    }
+    EMFSD() {}
 
-    void set_counters(uint32_t _w, uint32_t * counters)
-    {
-        inited = true;
-        w = _w;
-        int max_cnt = collect_counters(counters);
-        n_new = w - counter_dist[0];
-//        std::cout << "w: " << w << std::endl;
-//        std::cout << "dist0: " << counter_dist[0] << std::endl;
-        dist_new.resize(counter_dist.size());
-        ns.resize(counter_dist.size());
-        for (uint32_t i = 1; i < counter_dist.size(); ++i) {
-            dist_new[i] = counter_dist[i] / double(w - counter_dist[0]);
-            ns[i] = counter_dist[i];
-        }
-    }
+    // threads used by next_epoch, 1 runs it on the calling thread
+    void set_threads(int n) { thread_num = n > 0 ? n : 1; }
 
-    void set_counters(uint32_t _w, uint16_t * counters)
+    // Starts an estimate from w counters. With warm_start, the previous
+    // estimate of this object, e.g. that of the previous window, is the
+    // initial distribution instead of the counter values, so run() needs
+    // fewer epochs when the traffic changes little.
+    template<typename T>
+    void set_counters(uint32_t _w, const T * counters, bool warm_start = false)
     {
+        vector<double> prev;
+        if (warm_start && inited)
+            prev.swap(ns);
+
         inited = true;
         w = _w;
-        int max_cnt = collect_counters(counters);
+        collect_counters(counters);
         n_new = w - counter_dist[0];
-        dist_new.resize(counter_dist.size());
-        ns.resize(counter_dist.size());
+        dist_new.assign(counter_dist.size(), 0);
+        ns.assign(counter_dist.size(), 0);
         for (uint32_t i = 1; i < counter_dist.size(); ++i) {
             dist_new[i] = counter_dist[i] / double(w - counter_dist[0]);
             ns[i] = counter_dist[i];
         }
         card_init = (w * std::log(w / double(counter_dist[0])));
+
+        // sizes the previous estimate gave no flows keep their counter share,
+        // EM could never give them any otherwise
+        double prev_n = 0;
+        for (uint32_t i = 1; i < prev.size() && i < dist_new.size(); ++i)
+            prev_n += prev[i];
+        if (prev_n > 0) {
+            double sum = 0;
+            for (uint32_t i = 1; i < dist_new.size(); ++i) {
+                if (i < prev.size() && prev[i] > 0)
+                    dist_new[i] = prev[i] / prev_n;
+                sum += dist_new[i];
+            }
+            for (uint32_t i = 1; i < dist_new.size(); ++i)
+                dist_new[i] /= sum;
+            n_new = prev_n;
+        }
+
+        for (uint32_t i = 1; i < counter_dist.size(); ++i)
+            if (counter_dist[i])
+                cache_combs(i);
     }
 
     void next_epoch()
@@ -216,40 +269,57 @@ public:
         n_old = n_new;
 
         double lambda = n_old / double(w);
+        vector<double> lambda_i(dist_old.size());
+        for (uint32_t s = 1; s < dist_old.size(); ++s)
+            lambda_i[s] = n_old * dist_old[s] / w;
 
         std::fill(ns.begin(), ns.end(), 0);
 
-        for (uint32_t i = 1; i < counter_dist.size(); ++i) {
-            // enum how to form val:i
-            if (counter_dist[i] == 0) {
-                continue;
-            }
-            BetaGenerator bts1(i), bts2(i);
-            double sum_p = 0;
-            while (bts1.get_next()) {
-                double p = get_p_from_beta(bts1, lambda, dist_old, n_old);
-                sum_p += p;
-            }
-            while (bts2.get_next()) {
-                double p = get_p_from_beta(bts2, lambda, dist_old, n_old);
-                for (int j = 0; j < bts2.now_flow_num; ++j) {
-                    ns[bts2.now_result[j]] += counter_dist[i] * p / sum_p;
-                }
-            }
+        // the values are dealt round robin, the large ones having the most
+        // ways to be formed
+        int threads = std::min<int>(thread_num, counter_dist.size());
+        if (threads <= 1) {
+            expect(1, 1, lambda_i, lambda, ns);
+        } else {
+            vector<vector<double>> outs(threads, vector<double>(ns.size(), 0));
+            vector<std::thread> workers;
+            for (int t = 1; t < threads; ++t)
+                workers.emplace_back([&, t]() { expect(1 + t, threads, lambda_i, lambda, outs[t]); });
+            expect(1, threads, lambda_i, lambda, outs[0]);
+            for (auto &worker : workers)
+                worker.join();
+            for (int t = 0; t < threads; ++t)
+                for (uint32_t s = 1; s < ns.size(); ++s)
+                    ns[s] += outs[t][s];
         }
 
         n_new = 0;
         for (uint32_t i = 1; i < counter_dist.size(); i++) {
-//            ns[i] = int(ns[i]); // TODO
             n_new += ns[i];
         }
         for (uint32_t i = 1; i < counter_dist.size(); i++) {
-//            ns[i] = int(ns[i]);
             dist_new[i] = ns[i] / n_new;
         }
 
         n_sum = n_new;
-//        std::cout << ns[1] << std::endl;
+    }
+
+    // Runs epochs until the flow counts of two epochs differ by less than
+    // tolerance of the flows in total, at most max_epochs. Returns the
+    // epochs run.
+    int run(int max_epochs = 50, double tolerance = 1e-3)
+    {
+        vector<double> last;
+        for (int epoch = 1; epoch <= max_epochs; ++epoch) {
+            last = ns;
+            next_epoch();
+            double diff = 0;
+            for (uint32_t s = 1; s < ns.size(); ++s)
+                diff += std::fabs(ns[s] - last[s]);
+            if (diff < tolerance * n_new)
+                return epoch;
+        }
+        return max_epochs;
     }
 };
 
@@ -0,0 +1,177 @@
+#ifndef _BUCKET_KERNEL_H_
+#define _BUCKET_KERNEL_H_
+
+#include <x86intrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Match/min routine of the 8-slot buckets used by Elastic, 1FA and 2FASketch:
+// key[8] immediately followed by val[8], lane 7 of val is the guard.
+//
+// Returns the index of the first key equal to fp, or -1. When there is no
+// match, min_counter/min_val are the first slot among lanes 0..6 holding the
+// smallest (val & 0x7FFFFFFF).
+//
+// One kernel per instruction set is compiled with a target attribute. A build
+// without -mavx2 picks the best one the CPU supports at startup, so a single
+// binary runs everywhere and still uses AVX-512/AVX2 where available; set
+// SKETCH_SIMD=scalar|sse41|avx2|avx512 to force a kernel. A build that already
+// targets AVX2 calls that kernel directly so it inlines into the insert path,
+// unless SKETCH_RUNTIME_DISPATCH is defined.
+typedef int (*bucket_match_min_t)(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val);
+
+#define BUCKET_KERNEL_SLOTS 8
+#define BUCKET_KERNEL_VALID 7
+#define BUCKET_KERNEL_VAL_MASK 0x7FFFFFFF
+
+// reference version, also used to check the SIMD kernels
+static inline int bucket_match_min_scalar(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	const uint32_t *val = key + BUCKET_KERNEL_SLOTS;
+	for (int i = 0; i < BUCKET_KERNEL_SLOTS; ++i)
+		if (key[i] == fp)
+			return i;
+
+	min_counter = 0;
+	min_val = val[0] & BUCKET_KERNEL_VAL_MASK;
+	for (int i = 1; i < BUCKET_KERNEL_VALID; ++i)
+	{
+		uint32_t v = val[i] & BUCKET_KERNEL_VAL_MASK;
+		if (v < min_val)
+		{
+			min_val = v;
+			min_counter = i;
+		}
+	}
+	return -1;
+}
+
+__attribute__((target("sse4.1")))
+static inline int bucket_match_min_sse41(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	const __m128i item = _mm_set1_epi32((int)fp);
+	__m128i k0 = _mm_loadu_si128((const __m128i *)key);
+	__m128i k1 = _mm_loadu_si128((const __m128i *)(key + 4));
+	int matched = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(item, k0)))
+				| (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(item, k1))) << 4);
+	if (matched != 0)
+		return __builtin_ctz(matched);
+
+	const __m128i masks = _mm_set1_epi32(BUCKET_KERNEL_VAL_MASK);
+	__m128i v0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(key + BUCKET_KERNEL_SLOTS)), masks);
+	__m128i v1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(key + BUCKET_KERNEL_SLOTS + 4)), masks);
+	v1 = _mm_or_si128(v1, _mm_set_epi32(BUCKET_KERNEL_VAL_MASK, 0, 0, 0));
+
+	__m128i x = _mm_min_epi32(v0, v1);
+	x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2)));
+	x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 0, 1)));
+	int min_counter_val = _mm_cvtsi128_si32(x);
+
+	const __m128i ct_item = _mm_set1_epi32(min_counter_val);
+	matched = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ct_item, v0)))
+			| (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ct_item, v1))) << 4);
+	min_counter = __builtin_ctz(matched);
+	min_val = (uint32_t)min_counter_val;
+	return -1;
+}
+
+__attribute__((target("avx2")))
+static inline int bucket_match_min_avx2(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	const __m256i item = _mm256_set1_epi32((int)fp);
+	__m256i a_comp = _mm256_cmpeq_epi32(item, _mm256_loadu_si256((const __m256i *)key));
+	int matched = _mm256_movemask_ps(_mm256_castsi256_ps(a_comp));
+	if (matched != 0)
+		return __builtin_ctz(matched);
+
+	const uint32_t mask_base = BUCKET_KERNEL_VAL_MASK;
+	__m256i results = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(key + BUCKET_KERNEL_SLOTS)),
+									   _mm256_set1_epi32(mask_base));
+	results = _mm256_or_si256(results, _mm256_set_epi32(mask_base, 0, 0, 0, 0, 0, 0, 0));
+
+	__m128i low_part = _mm256_castsi256_si128(results);
+	__m128i high_part = _mm256_extracti128_si256(results, 1);
+
+	__m128i x = _mm_min_epi32(low_part, high_part);
+	__m128i min1 = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
+	__m128i min2 = _mm_min_epi32(x, min1);
+	__m128i min3 = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
+	__m128i min4 = _mm_min_epi32(min2, min3);
+	int min_counter_val = _mm_cvtsi128_si32(min4);
+
+	__m256i ct_a_comp = _mm256_cmpeq_epi32(_mm256_set1_epi32(min_counter_val), results);
+	matched = _mm256_movemask_ps(_mm256_castsi256_ps(ct_a_comp));
+	min_counter = __builtin_ctz(matched);
+	min_val = (uint32_t)min_counter_val;
+	return -1;
+}
+
+// the whole 64-byte bucket in one register: keys in lanes 0..7, counters in 8..15
+__attribute__((target("avx512f")))
+static inline int bucket_match_min_avx512(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	__m512i line = _mm512_loadu_si512((const void *)key);
+	__mmask16 matched = _mm512_mask_cmpeq_epi32_mask(0x00FF, line, _mm512_set1_epi32((int)fp));
+	if (matched != 0)
+		return __builtin_ctz(matched);
+
+	const __mmask16 valid = (__mmask16)(((1u << BUCKET_KERNEL_VALID) - 1) << BUCKET_KERNEL_SLOTS);
+	__m512i results = _mm512_and_si512(line, _mm512_set1_epi32(BUCKET_KERNEL_VAL_MASK));
+	int min_counter_val = _mm512_mask_reduce_min_epi32(valid, results);
+
+	matched = _mm512_mask_cmpeq_epi32_mask(valid, results, _mm512_set1_epi32(min_counter_val));
+	min_counter = __builtin_ctz(matched) - BUCKET_KERNEL_SLOTS;
+	min_val = (uint32_t)min_counter_val;
+	return -1;
+}
+
+#if defined(__AVX2__) && !defined(SKETCH_RUNTIME_DISPATCH)
+static const char *const bucket_kernel_name = "avx2";
+
+static inline int bucket_match_min(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	return bucket_match_min_avx2(key, fp, min_counter, min_val);
+}
+#else
+static const char *bucket_kernel_name = "scalar";
+
+static bucket_match_min_t select_bucket_match_min()
+{
+	struct { const char *name; bool supported; bucket_match_min_t kernel; } kernels[] = {
+		{"avx512", false, bucket_match_min_avx512},
+		{"avx2", false, bucket_match_min_avx2},
+		{"sse41", false, bucket_match_min_sse41},
+		{"scalar", true, bucket_match_min_scalar},
+	};
+	__builtin_cpu_init();
+	kernels[0].supported = __builtin_cpu_supports("avx512f");
+	kernels[1].supported = __builtin_cpu_supports("avx2");
+	kernels[2].supported = __builtin_cpu_supports("sse4.1");
+
+	// a forced kernel the CPU cannot run falls back to the best supported one
+	const char *forced = getenv("SKETCH_SIMD");
+	for (auto &k : kernels)
+		if (forced && k.supported && strcmp(forced, k.name) == 0)
+		{
+			bucket_kernel_name = k.name;
+			return k.kernel;
+		}
+	for (auto &k : kernels)
+		if (k.supported)
+		{
+			bucket_kernel_name = k.name;
+			return k.kernel;
+		}
+	return bucket_match_min_scalar;
+}
+
+static const bucket_match_min_t bucket_match_min_dispatch = select_bucket_match_min();
+
+static inline int bucket_match_min(const uint32_t *key, uint32_t fp, int &min_counter, uint32_t &min_val)
+{
+	return bucket_match_min_dispatch(key, fp, min_counter, min_val);
+}
+#endif
+
+#endif
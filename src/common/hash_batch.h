@@ -0,0 +1,482 @@
+#ifndef _HASH_BATCH_H_
+#define _HASH_BATCH_H_
+
+#include <x86intrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BOBHash32.h"
+
+// Batch versions of BOBHash32::run and MurmurHash3_x86_32, the hashes every
+// sketch (and the zipf generator in data/zipf) computes one key at a time:
+//  *_batch  n keys of key_len bytes, stride bytes apart, under one seed
+//  *_seeds  one key under n seeds
+// For BOBHash32 a seed is a prime index, as in BOBHash32(prime32Num). The
+// results are exactly those of the scalar hashes, signed chars of BOBHash32
+// included.
+//
+// The AVX2 kernels hash 8 lanes at a time and the AVX-512 ones 16, loading
+// the words of strided keys with gathers (4-byte keys stored back to back
+// with plain loads). Keys shorter than 4 bytes and the last n % lanes keys
+// go through the scalar code. As with bucket_kernel.h, the best kernel the
+// CPU supports is picked at startup and SKETCH_SIMD=scalar|avx2|avx512
+// forces one.
+
+typedef void (*hash_batch_t)(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out);
+typedef void (*hash_seeds_t)(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out);
+
+struct HashBatchKernel
+{
+	const char *name;
+	hash_batch_t bob_batch;
+	hash_seeds_t bob_seeds;
+	hash_batch_t murmur_batch;
+	hash_seeds_t murmur_seeds;
+};
+
+/* scalar */
+static inline uint32_t murmur3_32(const uint8_t *key, int len, uint32_t seed)
+{
+	const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+	uint32_t h = seed, k;
+	int i = 0;
+	for (; i + 4 <= len; i += 4)
+	{
+		memcpy(&k, key + i, 4);
+		k *= c1;
+		k = (k << 15) | (k >> 17);
+		k *= c2;
+		h ^= k;
+		h = (h << 13) | (h >> 19);
+		h = h * 5 + 0xe6546b64;
+	}
+	if (i < len)
+	{
+		k = 0;
+		memcpy(&k, key + i, len - i);
+		k *= c1;
+		k = (k << 15) | (k >> 17);
+		k *= c2;
+		h ^= k;
+	}
+	h ^= (uint32_t)len;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+static void bob_hash32_batch_scalar(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	BOBHash32 hash(seed);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = hash.run((const char *)(keys + i * stride), key_len);
+}
+
+static void bob_hash32_seeds_scalar(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = BOBHash32(seeds[i]).run((const char *)key, key_len);
+}
+
+static void murmur3_32_batch_scalar(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = murmur3_32(keys + i * stride, key_len, seed);
+}
+
+static void murmur3_32_seeds_scalar(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = murmur3_32(key, key_len, seeds[i]);
+}
+
+// how the lanes find their key words
+enum HashLoad
+{
+	HASH_LOAD_SAME = 0,		// one key for all lanes
+	HASH_LOAD_PACKED = 1,	// 4-byte keys back to back
+	HASH_LOAD_GATHER = 2
+};
+
+static inline int hash_load_mode(size_t stride, int key_len)
+{
+	return stride == 4 && key_len == 4 ? HASH_LOAD_PACKED : HASH_LOAD_GATHER;
+}
+
+/* AVX2, 8 lanes */
+__attribute__((target("avx2")))
+static inline __m256i hash_word_avx2(const uint8_t *p, __m256i offs, int mode, int o, int k)
+{
+	// the k (1..4) bytes at offset o of every lane's key, read as the last
+	// bytes of a word so that nothing past the key is touched
+	const uint8_t *q = p + o + k - 4;
+	__m256i w;
+	if (mode == HASH_LOAD_SAME)
+	{
+		uint32_t x;
+		memcpy(&x, q, 4);
+		w = _mm256_set1_epi32((int)x);
+	}
+	else if (mode == HASH_LOAD_PACKED)
+		w = _mm256_loadu_si256((const __m256i *)q);
+	else
+		w = _mm256_i32gather_epi32((const int *)q, offs, 1);
+	return k == 4 ? w : _mm256_srli_epi32(w, 8 * (4 - k));
+}
+
+// the bytes of w added as BOBHash32 does, as signed chars shifted left by s
+__attribute__((target("avx2")))
+static inline __m256i bob_chars_avx2(__m256i w, int s)
+{
+	__m256i sign = _mm256_and_si256(w, _mm256_set1_epi32((int)0x80808080));
+	return _mm256_sub_epi32(_mm256_slli_epi32(w, s), _mm256_slli_epi32(sign, s + 1));
+}
+
+#define BOB_STEP_AVX2(x, y, z, shift, n) \
+	x = _mm256_sub_epi32(_mm256_sub_epi32(x, y), z); \
+	x = _mm256_xor_si256(x, shift(z, n));
+
+__attribute__((target("avx2")))
+static inline __m256i bob_hash32_avx2(const uint8_t *p, __m256i offs, int mode, int key_len, __m256i c)
+{
+	__m256i a = _mm256_set1_epi32((int)0x9e3779b9), b = a;
+	int o = 0, len = key_len;
+	for (;; o += 12, len -= 12)
+	{
+		if (len >= 12)
+		{
+			a = _mm256_add_epi32(a, bob_chars_avx2(hash_word_avx2(p, offs, mode, o, 4), 0));
+			b = _mm256_add_epi32(b, bob_chars_avx2(hash_word_avx2(p, offs, mode, o + 4, 4), 0));
+			c = _mm256_add_epi32(c, bob_chars_avx2(hash_word_avx2(p, offs, mode, o + 8, 4), 0));
+		}
+		else
+		{
+			// the last 11 bytes, the first byte of c is the length
+			c = _mm256_add_epi32(c, _mm256_set1_epi32(len));
+			if (len > 8)
+				c = _mm256_add_epi32(c, bob_chars_avx2(hash_word_avx2(p, offs, mode, o + 8, len - 8), 8));
+			if (len > 4)
+				b = _mm256_add_epi32(b, bob_chars_avx2(hash_word_avx2(p, offs, mode, o + 4, len > 8 ? 4 : len - 4), 0));
+			if (len > 0)
+				a = _mm256_add_epi32(a, bob_chars_avx2(hash_word_avx2(p, offs, mode, o, len > 4 ? 4 : len), 0));
+		}
+		BOB_STEP_AVX2(a, b, c, _mm256_srli_epi32, 13)
+		BOB_STEP_AVX2(b, c, a, _mm256_slli_epi32, 8)
+		BOB_STEP_AVX2(c, a, b, _mm256_srli_epi32, 13)
+		BOB_STEP_AVX2(a, b, c, _mm256_srli_epi32, 12)
+		BOB_STEP_AVX2(b, c, a, _mm256_slli_epi32, 16)
+		BOB_STEP_AVX2(c, a, b, _mm256_srli_epi32, 5)
+		BOB_STEP_AVX2(a, b, c, _mm256_srli_epi32, 3)
+		BOB_STEP_AVX2(b, c, a, _mm256_slli_epi32, 10)
+		BOB_STEP_AVX2(c, a, b, _mm256_srli_epi32, 15)
+		if (len < 12)
+			return c;
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rotl_avx2(__m256i x, int r)
+{
+	return _mm256_or_si256(_mm256_slli_epi32(x, r), _mm256_srli_epi32(x, 32 - r));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i murmur3_k_avx2(__m256i k)
+{
+	k = _mm256_mullo_epi32(k, _mm256_set1_epi32((int)0xcc9e2d51));
+	k = rotl_avx2(k, 15);
+	return _mm256_mullo_epi32(k, _mm256_set1_epi32(0x1b873593));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i murmur3_32_avx2(const uint8_t *p, __m256i offs, int mode, int key_len, __m256i h)
+{
+	int o = 0;
+	for (; o + 4 <= key_len; o += 4)
+	{
+		h = _mm256_xor_si256(h, murmur3_k_avx2(hash_word_avx2(p, offs, mode, o, 4)));
+		h = rotl_avx2(h, 13);
+		h = _mm256_add_epi32(_mm256_add_epi32(h, _mm256_slli_epi32(h, 2)), _mm256_set1_epi32((int)0xe6546b64));
+	}
+	if (o < key_len)
+		h = _mm256_xor_si256(h, murmur3_k_avx2(hash_word_avx2(p, offs, mode, o, key_len - o)));
+	h = _mm256_xor_si256(h, _mm256_set1_epi32(key_len));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x85ebca6b));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0xc2b2ae35));
+	return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i stride_offsets_avx2(size_t stride)
+{
+	return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+}
+
+__attribute__((target("avx2")))
+static void bob_hash32_batch_avx2(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+	{
+		const __m256i offs = stride_offsets_avx2(stride), c = _mm256_set1_epi32((int)prime32[seed]);
+		int mode = hash_load_mode(stride, key_len);
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_si256((__m256i *)(out + i), bob_hash32_avx2(keys + i * stride, offs, mode, key_len, c));
+	}
+	bob_hash32_batch_scalar(keys + i * stride, n - i, stride, key_len, seed, out + i);
+}
+
+__attribute__((target("avx2")))
+static void bob_hash32_seeds_avx2(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i c = _mm256_i32gather_epi32((const int *)prime32, _mm256_loadu_si256((const __m256i *)(seeds + i)), 4);
+			_mm256_storeu_si256((__m256i *)(out + i), bob_hash32_avx2(key, _mm256_setzero_si256(), HASH_LOAD_SAME, key_len, c));
+		}
+	bob_hash32_seeds_scalar(key, key_len, seeds + i, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static void murmur3_32_batch_avx2(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+	{
+		const __m256i offs = stride_offsets_avx2(stride), h = _mm256_set1_epi32((int)seed);
+		int mode = hash_load_mode(stride, key_len);
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_si256((__m256i *)(out + i), murmur3_32_avx2(keys + i * stride, offs, mode, key_len, h));
+	}
+	murmur3_32_batch_scalar(keys + i * stride, n - i, stride, key_len, seed, out + i);
+}
+
+__attribute__((target("avx2")))
+static void murmur3_32_seeds_avx2(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i h = _mm256_loadu_si256((const __m256i *)(seeds + i));
+			_mm256_storeu_si256((__m256i *)(out + i), murmur3_32_avx2(key, _mm256_setzero_si256(), HASH_LOAD_SAME, key_len, h));
+		}
+	murmur3_32_seeds_scalar(key, key_len, seeds + i, n - i, out + i);
+}
+
+/* AVX-512, 16 lanes */
+__attribute__((target("avx512f")))
+static inline __m512i hash_word_avx512(const uint8_t *p, __m512i offs, int mode, int o, int k)
+{
+	const uint8_t *q = p + o + k - 4;
+	__m512i w;
+	if (mode == HASH_LOAD_SAME)
+	{
+		uint32_t x;
+		memcpy(&x, q, 4);
+		w = _mm512_set1_epi32((int)x);
+	}
+	else if (mode == HASH_LOAD_PACKED)
+		w = _mm512_loadu_si512((const void *)q);
+	else
+		w = _mm512_i32gather_epi32(offs, (const void *)q, 1);
+	return k == 4 ? w : _mm512_srli_epi32(w, 8 * (4 - k));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i bob_chars_avx512(__m512i w, int s)
+{
+	__m512i sign = _mm512_and_si512(w, _mm512_set1_epi32((int)0x80808080));
+	return _mm512_sub_epi32(_mm512_slli_epi32(w, s), _mm512_slli_epi32(sign, s + 1));
+}
+
+#define BOB_STEP_AVX512(x, y, z, shift, n) \
+	x = _mm512_sub_epi32(_mm512_sub_epi32(x, y), z); \
+	x = _mm512_xor_si512(x, shift(z, n));
+
+__attribute__((target("avx512f")))
+static inline __m512i bob_hash32_avx512(const uint8_t *p, __m512i offs, int mode, int key_len, __m512i c)
+{
+	__m512i a = _mm512_set1_epi32((int)0x9e3779b9), b = a;
+	int o = 0, len = key_len;
+	for (;; o += 12, len -= 12)
+	{
+		if (len >= 12)
+		{
+			a = _mm512_add_epi32(a, bob_chars_avx512(hash_word_avx512(p, offs, mode, o, 4), 0));
+			b = _mm512_add_epi32(b, bob_chars_avx512(hash_word_avx512(p, offs, mode, o + 4, 4), 0));
+			c = _mm512_add_epi32(c, bob_chars_avx512(hash_word_avx512(p, offs, mode, o + 8, 4), 0));
+		}
+		else
+		{
+			c = _mm512_add_epi32(c, _mm512_set1_epi32(len));
+			if (len > 8)
+				c = _mm512_add_epi32(c, bob_chars_avx512(hash_word_avx512(p, offs, mode, o + 8, len - 8), 8));
+			if (len > 4)
+				b = _mm512_add_epi32(b, bob_chars_avx512(hash_word_avx512(p, offs, mode, o + 4, len > 8 ? 4 : len - 4), 0));
+			if (len > 0)
+				a = _mm512_add_epi32(a, bob_chars_avx512(hash_word_avx512(p, offs, mode, o, len > 4 ? 4 : len), 0));
+		}
+		BOB_STEP_AVX512(a, b, c, _mm512_srli_epi32, 13)
+		BOB_STEP_AVX512(b, c, a, _mm512_slli_epi32, 8)
+		BOB_STEP_AVX512(c, a, b, _mm512_srli_epi32, 13)
+		BOB_STEP_AVX512(a, b, c, _mm512_srli_epi32, 12)
+		BOB_STEP_AVX512(b, c, a, _mm512_slli_epi32, 16)
+		BOB_STEP_AVX512(c, a, b, _mm512_srli_epi32, 5)
+		BOB_STEP_AVX512(a, b, c, _mm512_srli_epi32, 3)
+		BOB_STEP_AVX512(b, c, a, _mm512_slli_epi32, 10)
+		BOB_STEP_AVX512(c, a, b, _mm512_srli_epi32, 15)
+		if (len < 12)
+			return c;
+	}
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i murmur3_k_avx512(__m512i k)
+{
+	k = _mm512_mullo_epi32(k, _mm512_set1_epi32((int)0xcc9e2d51));
+	k = _mm512_rol_epi32(k, 15);
+	return _mm512_mullo_epi32(k, _mm512_set1_epi32(0x1b873593));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i murmur3_32_avx512(const uint8_t *p, __m512i offs, int mode, int key_len, __m512i h)
+{
+	int o = 0;
+	for (; o + 4 <= key_len; o += 4)
+	{
+		h = _mm512_xor_si512(h, murmur3_k_avx512(hash_word_avx512(p, offs, mode, o, 4)));
+		h = _mm512_rol_epi32(h, 13);
+		h = _mm512_add_epi32(_mm512_add_epi32(h, _mm512_slli_epi32(h, 2)), _mm512_set1_epi32((int)0xe6546b64));
+	}
+	if (o < key_len)
+		h = _mm512_xor_si512(h, murmur3_k_avx512(hash_word_avx512(p, offs, mode, o, key_len - o)));
+	h = _mm512_xor_si512(h, _mm512_set1_epi32(key_len));
+	h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+	h = _mm512_mullo_epi32(h, _mm512_set1_epi32((int)0x85ebca6b));
+	h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+	h = _mm512_mullo_epi32(h, _mm512_set1_epi32((int)0xc2b2ae35));
+	return _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i stride_offsets_avx512(size_t stride)
+{
+	return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+							  _mm512_set1_epi32((int)stride));
+}
+
+__attribute__((target("avx512f")))
+static void bob_hash32_batch_avx512(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+	{
+		const __m512i offs = stride_offsets_avx512(stride), c = _mm512_set1_epi32((int)prime32[seed]);
+		int mode = hash_load_mode(stride, key_len);
+		for (; i + 16 <= n; i += 16)
+			_mm512_storeu_si512((void *)(out + i), bob_hash32_avx512(keys + i * stride, offs, mode, key_len, c));
+	}
+	bob_hash32_batch_scalar(keys + i * stride, n - i, stride, key_len, seed, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void bob_hash32_seeds_avx512(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+		for (; i + 16 <= n; i += 16)
+		{
+			__m512i c = _mm512_i32gather_epi32(_mm512_loadu_si512((const void *)(seeds + i)), (const void *)prime32, 4);
+			_mm512_storeu_si512((void *)(out + i), bob_hash32_avx512(key, _mm512_setzero_si512(), HASH_LOAD_SAME, key_len, c));
+		}
+	bob_hash32_seeds_scalar(key, key_len, seeds + i, n - i, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void murmur3_32_batch_avx512(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+	{
+		const __m512i offs = stride_offsets_avx512(stride), h = _mm512_set1_epi32((int)seed);
+		int mode = hash_load_mode(stride, key_len);
+		for (; i + 16 <= n; i += 16)
+			_mm512_storeu_si512((void *)(out + i), murmur3_32_avx512(keys + i * stride, offs, mode, key_len, h));
+	}
+	murmur3_32_batch_scalar(keys + i * stride, n - i, stride, key_len, seed, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void murmur3_32_seeds_avx512(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	size_t i = 0;
+	if (key_len >= 4)
+		for (; i + 16 <= n; i += 16)
+		{
+			__m512i h = _mm512_loadu_si512((const void *)(seeds + i));
+			_mm512_storeu_si512((void *)(out + i), murmur3_32_avx512(key, _mm512_setzero_si512(), HASH_LOAD_SAME, key_len, h));
+		}
+	murmur3_32_seeds_scalar(key, key_len, seeds + i, n - i, out + i);
+}
+
+/* dispatch */
+static const HashBatchKernel hash_batch_kernels[] = {
+	{"avx512", bob_hash32_batch_avx512, bob_hash32_seeds_avx512, murmur3_32_batch_avx512, murmur3_32_seeds_avx512},
+	{"avx2", bob_hash32_batch_avx2, bob_hash32_seeds_avx2, murmur3_32_batch_avx2, murmur3_32_seeds_avx2},
+	{"scalar", bob_hash32_batch_scalar, bob_hash32_seeds_scalar, murmur3_32_batch_scalar, murmur3_32_seeds_scalar},
+};
+
+static inline bool hash_batch_supported(const HashBatchKernel &k)
+{
+	__builtin_cpu_init();
+	if (strcmp(k.name, "avx512") == 0)
+		return __builtin_cpu_supports("avx512f");
+	if (strcmp(k.name, "avx2") == 0)
+		return __builtin_cpu_supports("avx2");
+	return true;
+}
+
+static const HashBatchKernel &select_hash_batch_kernel()
+{
+	// a forced kernel the CPU cannot run falls back to the best supported one
+	const char *forced = getenv("SKETCH_SIMD");
+	for (auto &k : hash_batch_kernels)
+		if (forced && strcmp(forced, k.name) == 0 && hash_batch_supported(k))
+			return k;
+	for (auto &k : hash_batch_kernels)
+		if (hash_batch_supported(k))
+			return k;
+	return hash_batch_kernels[2];
+}
+
+static const HashBatchKernel &hash_batch_kernel = select_hash_batch_kernel();
+
+static inline void bob_hash32_batch(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t prime_index, uint32_t *out)
+{
+	hash_batch_kernel.bob_batch(keys, n, stride, key_len, prime_index, out);
+}
+
+static inline void bob_hash32_seeds(const uint8_t *key, int key_len, const uint32_t *prime_indexes, size_t n, uint32_t *out)
+{
+	hash_batch_kernel.bob_seeds(key, key_len, prime_indexes, n, out);
+}
+
+static inline void murmur3_32_batch(const uint8_t *keys, size_t n, size_t stride, int key_len, uint32_t seed, uint32_t *out)
+{
+	hash_batch_kernel.murmur_batch(keys, n, stride, key_len, seed, out);
+}
+
+static inline void murmur3_32_seeds(const uint8_t *key, int key_len, const uint32_t *seeds, size_t n, uint32_t *out)
+{
+	hash_batch_kernel.murmur_seeds(key, key_len, seeds, n, out);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef _LATENCY_HIST_H_
+#define _LATENCY_HIST_H_
+
+#include <x86intrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// Per-insert latency instrumentation, opt-in with -DLATENCY_HIST.
+//
+// Outcomes of one heavy part insert. The heavy parts mark the ones taken with
+// RECORD_INSERT_OUTCOME; without LATENCY_HIST the macro is empty and the
+// insert paths are unchanged.
+enum InsertOutcome
+{
+	INSERT_HIT,		// key already in the bucket
+	INSERT_EMPTY,	// stored in an empty slot
+	INSERT_GUARD,	// guard counter incremented, not stored
+	INSERT_SWAP,	// replaced the smallest counter
+	INSERT_BACKUP,	// primary bucket above thres_set, went to the backup bucket
+	INSERT_OTHER,	// no outcome recorded, e.g. sketches without a heavy part
+	INSERT_OUTCOME_NUM
+};
+
+static const char *const insert_outcome_name[INSERT_OUTCOME_NUM] = {
+	"hit", "empty", "guard", "swap", "backup", "other"
+};
+
+// one mask per thread, shared by every translation unit
+inline uint32_t &insert_outcome_mask()
+{
+	static thread_local uint32_t mask = 0;
+	return mask;
+}
+
+#ifdef LATENCY_HIST
+#define RECORD_INSERT_OUTCOME(o) (insert_outcome_mask() |= 1u << (o))
+#else
+#define RECORD_INSERT_OUTCOME(o) ((void)0)
+#endif
+
+// Outcome of the insert since the mask was last cleared. A backup insert also
+// records the outcome in the backup bucket, the backup path wins.
+static inline int take_insert_outcome()
+{
+	uint32_t mask = insert_outcome_mask();
+	insert_outcome_mask() = 0;
+	if (mask & (1u << INSERT_BACKUP))
+		return INSERT_BACKUP;
+	if (mask == 0)
+		return INSERT_OTHER;
+	return __builtin_ctz(mask);
+}
+
+// rdtsc fenced so the measured insert can neither start before the first
+// read nor still be running at the second one
+static inline uint64_t rdtsc_begin()
+{
+	_mm_lfence();
+	uint64_t t = __rdtsc();
+	_mm_lfence();
+	return t;
+}
+
+static inline uint64_t rdtsc_end()
+{
+	unsigned int aux;
+	uint64_t t = __rdtscp(&aux);
+	_mm_lfence();
+	return t;
+}
+
+// HDR-style histogram of cycle counts: values below 2^LATENCY_SUB_BITS are
+// exact, larger ones fall in one of 2^LATENCY_SUB_BITS linear sub-buckets of
+// their power of two, so any percentile is within 1/2^LATENCY_SUB_BITS (~3%).
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_NUM (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKET_NUM ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_NUM)
+
+class LatencyHist
+{
+	uint64_t counts[LATENCY_BUCKET_NUM];
+	uint64_t total, max_value;
+
+	static int index_of(uint64_t v)
+	{
+		if (v < LATENCY_SUB_NUM)
+			return (int)v;
+		int msb = 63 - __builtin_clzll(v);
+		int shift = msb - LATENCY_SUB_BITS;
+		return (shift + 1) * LATENCY_SUB_NUM + (int)((v >> shift) - LATENCY_SUB_NUM);
+	}
+
+	// largest value falling in bucket i
+	static uint64_t value_of(int i)
+	{
+		if (i < LATENCY_SUB_NUM)
+			return i;
+		int shift = i / LATENCY_SUB_NUM - 1;
+		uint64_t sub = i % LATENCY_SUB_NUM + LATENCY_SUB_NUM;
+		return ((sub + 1) << shift) - 1;
+	}
+
+public:
+	LatencyHist()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		memset(counts, 0, sizeof(counts));
+		total = max_value = 0;
+	}
+
+	void record(uint64_t v)
+	{
+		counts[index_of(v)]++;
+		total++;
+		if (v > max_value)
+			max_value = v;
+	}
+
+	void merge(const LatencyHist &other)
+	{
+		for (int i = 0; i < LATENCY_BUCKET_NUM; ++i)
+			counts[i] += other.counts[i];
+		total += other.total;
+		if (other.max_value > max_value)
+			max_value = other.max_value;
+	}
+
+	// p in [0, 1]
+	uint64_t percentile(double p) const
+	{
+		if (total == 0)
+			return 0;
+		uint64_t rank = (uint64_t)(p * total);
+		if (rank >= total)
+			rank = total - 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < LATENCY_BUCKET_NUM; ++i)
+		{
+			seen += counts[i];
+			if (seen > rank)
+				return value_of(i) < max_value ? value_of(i) : max_value;
+		}
+		return max_value;
+	}
+
+	uint64_t count() const { return total; }
+	uint64_t max() const { return max_value; }
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef _ROW_HASH_H_
+#define _ROW_HASH_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "BOBHash32.h"
+
+// Hashing policies of the d-row sketches (CMHeap, CountHeap, ChainSketch):
+// the column of a key in every row and, for CountHeap, its sign in every row.
+// The sketches take the policy as a template parameter:
+//  BobRowHash  one BOBHash32 per row and one more per row for the signs, as
+//              the sketches always did. d rows cost d (2d with signs) hashes
+//              of the key and d divisions.
+//  KMRowHash   one 64-bit hash of the key split into h1 and h2, row i uses
+//              h1 + i * h2 (Kirsch and Mitzenmacher, "Less hashing, same
+//              performance"). Columns are reduced with a multiply-shift and
+//              the signs are the top bits of one more multiply, so d rows
+//              cost one hash whatever d is.
+// Both are seeded with a BOBHash32 prime index, see sketch_seed.
+
+#define ROW_HASH_MAX_ROWS 8
+
+class BobRowHash
+{
+	BOBHash32 hash[ROW_HASH_MAX_ROWS];
+	BOBHash32 hash_polar[ROW_HASH_MAX_ROWS];
+	int rows = 0;
+
+public:
+	// row i uses prime index seed + i, its sign seed + rows + i
+	void init(int rows, uint32_t seed)
+	{
+		this->rows = rows;
+		for (int i = 0; i < rows; ++i)
+		{
+			hash[i].initialize((seed + i) % MAX_PRIME32);
+			hash_polar[i].initialize((seed + rows + i) % MAX_PRIME32);
+		}
+	}
+
+	void columns(const uint8_t *key, int key_len, uint32_t w, uint32_t *col)
+	{
+		for (int i = 0; i < rows; ++i)
+			col[i] = hash[i].run((const char *)key, key_len) % w;
+	}
+
+	// sign[i] is 1 or -1
+	void columns_signs(const uint8_t *key, int key_len, uint32_t w, uint32_t *col, int *sign)
+	{
+		columns(key, key_len, w, col);
+		for (int i = 0; i < rows; ++i)
+			sign[i] = hash_polar[i].run((const char *)key, key_len) % 2 ? 1 : -1;
+	}
+};
+
+class KMRowHash
+{
+	uint64_t seed64 = 0;
+	int rows = 0;
+
+	// MurmurHash3 finalizer, a bijection of 64-bit words
+	static uint64_t fmix64(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// keys of up to 8 bytes take one fmix64 and never collide
+	uint64_t hash64(const uint8_t *key, int key_len)
+	{
+		uint64_t h = seed64, word;
+		int i = 0;
+		for (; i + 8 <= key_len; i += 8)
+		{
+			memcpy(&word, key + i, 8);
+			h = fmix64(h ^ word);
+		}
+		if (i < key_len)
+		{
+			word = 0;
+			memcpy(&word, key + i, key_len - i);
+			h = fmix64(h ^ word);
+		}
+		return h;
+	}
+
+	void derive(uint64_t h, uint32_t w, uint32_t *col)
+	{
+		uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+		for (int i = 0; i < rows; ++i)
+			col[i] = (uint32_t)(((uint64_t)(h1 + i * h2) * w) >> 32);
+	}
+
+public:
+	void init(int rows, uint32_t seed)
+	{
+		this->rows = rows;
+		seed64 = fmix64(seed + 0x9E3779B97F4A7C15ull);
+	}
+
+	void columns(const uint8_t *key, int key_len, uint32_t w, uint32_t *col)
+	{
+		derive(hash64(key, key_len), w, col);
+	}
+
+	void columns_signs(const uint8_t *key, int key_len, uint32_t w, uint32_t *col, int *sign)
+	{
+		uint64_t h = hash64(key, key_len);
+		derive(h, w, col);
+		uint64_t s = h * 0xd6e8feb86659fd93ull;
+		for (int i = 0; i < rows; ++i)
+			sign[i] = (s >> (63 - i)) & 1 ? 1 : -1;
+	}
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef _SKETCH_ALLOC_H_
+#define _SKETCH_ALLOC_H_
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+// Memory of the large sketch tables: the sketch objects themselves (their
+// operator new), the Dynamic_2FASketch buckets and the CMHeap counter rows.
+// Past a few MB, random bucket accesses miss the TLB on nearly every insert
+// with 4KB pages. Backing the tables with 2MB or 1GB pages, and keeping them
+// on the NUMA node of the inserting threads, avoids that.
+//
+// The policy is process-wide, since operator new takes no arguments. It is
+// read once from the environment and can be overwritten before the sketches
+// are built:
+//   SKETCH_PAGES=thp|2m|1g  transparent hugepages (madvise), or 2MB / 1GB
+//                           pages reserved in /proc/sys/vm/nr_hugepages
+//                           (hugepages-1048576kB for 1GB)
+//   SKETCH_NUMA_NODE=n      bind the memory to node n (mbind, MPOL_BIND)
+// A page size that cannot be had falls back to the next smaller one, down to
+// 4KB pages; sketch_alloc_pages() tells which one a block got.
+
+enum SketchPages
+{
+	SKETCH_PAGES_DEFAULT = 0, // 4KB pages
+	SKETCH_PAGES_THP = 1,	  // 2MB-aligned, MADV_HUGEPAGE
+	SKETCH_PAGES_2M = 2,	  // MAP_HUGETLB, 2MB
+	SKETCH_PAGES_1G = 3		  // MAP_HUGETLB, 1GB
+};
+
+struct SketchAllocPolicy
+{
+	int pages;
+	int numa_node; // -1: no binding
+};
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define SKETCH_MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#define SKETCH_MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#define SKETCH_MPOL_BIND 2
+
+#define SKETCH_PAGE_4K ((size_t)4096)
+#define SKETCH_PAGE_2M ((size_t)2 << 20)
+#define SKETCH_PAGE_1G ((size_t)1 << 30)
+
+static inline SketchAllocPolicy sketch_alloc_policy_from_env()
+{
+	SketchAllocPolicy policy = {SKETCH_PAGES_DEFAULT, -1};
+	const char *pages = getenv("SKETCH_PAGES");
+	if (pages)
+	{
+		if (!strcmp(pages, "thp"))
+			policy.pages = SKETCH_PAGES_THP;
+		else if (!strcmp(pages, "2m"))
+			policy.pages = SKETCH_PAGES_2M;
+		else if (!strcmp(pages, "1g"))
+			policy.pages = SKETCH_PAGES_1G;
+	}
+	const char *node = getenv("SKETCH_NUMA_NODE");
+	if (node && *node)
+		policy.numa_node = atoi(node);
+	return policy;
+}
+
+// the process-wide policy, assignable
+static inline SketchAllocPolicy &sketch_alloc_policy()
+{
+	static SketchAllocPolicy policy = sketch_alloc_policy_from_env();
+	return policy;
+}
+
+static inline const char *sketch_pages_name(int pages)
+{
+	static const char *names[] = {"4k", "thp", "2m", "1g"};
+	return pages >= 0 && pages <= SKETCH_PAGES_1G ? names[pages] : "?";
+}
+
+// in the 64 bytes before every block, which keeps the block 64-byte aligned
+struct alignas(64) SketchAllocHeader
+{
+	void *base;		 // what to munmap/free
+	size_t map_size; // 0 if base came from posix_memalign
+	int pages;		 // the pages actually obtained
+	int numa_node;	 // the node bound to, -1 if none
+};
+
+static inline SketchAllocHeader *sketch_alloc_header(void *p)
+{
+	return (SketchAllocHeader *)p - 1;
+}
+
+static inline size_t sketch_round_up(size_t size, size_t align)
+{
+	return (size + align - 1) / align * align;
+}
+
+// mmap of len bytes with pages, MAP_FAILED if the kernel has none; THP
+// mappings are 2MB-aligned, *start is where the aligned part begins
+static inline void *sketch_map(size_t len, int pages, void **start)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (pages == SKETCH_PAGES_2M)
+		flags |= MAP_HUGETLB | SKETCH_MAP_HUGE_2MB;
+	else if (pages == SKETCH_PAGES_1G)
+		flags |= MAP_HUGETLB | SKETCH_MAP_HUGE_1GB;
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+	*start = p;
+	if (p != MAP_FAILED && pages == SKETCH_PAGES_THP)
+	{
+		*start = (void *)sketch_round_up((uintptr_t)p, SKETCH_PAGE_2M);
+		madvise(*start, len - SKETCH_PAGE_2M, MADV_HUGEPAGE);
+	}
+	return p;
+}
+
+// size bytes, 64-byte aligned, following policy; throws std::bad_alloc
+static inline void *sketch_alloc(size_t size, const SketchAllocPolicy &policy = sketch_alloc_policy())
+{
+	size_t total = size + sizeof(SketchAllocHeader);
+
+	if (policy.pages == SKETCH_PAGES_DEFAULT && policy.numa_node < 0)
+	{
+		void *q = NULL;
+		if (posix_memalign(&q, alignof(SketchAllocHeader), total) != 0)
+			throw std::bad_alloc();
+		SketchAllocHeader *h = (SketchAllocHeader *)q;
+		h->base = q, h->map_size = 0, h->pages = SKETCH_PAGES_DEFAULT, h->numa_node = -1;
+		return h + 1;
+	}
+
+	for (int pages = policy.pages; pages >= SKETCH_PAGES_DEFAULT; --pages)
+	{
+		size_t len;
+		if (pages == SKETCH_PAGES_1G)
+			len = sketch_round_up(total, SKETCH_PAGE_1G);
+		else if (pages == SKETCH_PAGES_2M)
+			len = sketch_round_up(total, SKETCH_PAGE_2M);
+		else if (pages == SKETCH_PAGES_THP)
+			len = sketch_round_up(total, SKETCH_PAGE_2M) + SKETCH_PAGE_2M; // room to align
+		else
+			len = sketch_round_up(total, SKETCH_PAGE_4K);
+
+		void *start;
+		void *p = sketch_map(len, pages, &start);
+		if (p == MAP_FAILED)
+			continue;
+
+		// before the first touch, which is what places the pages
+		int node = -1;
+		if (policy.numa_node >= 0 && policy.numa_node < 64)
+		{
+			unsigned long mask = 1ul << policy.numa_node;
+			if (syscall(SYS_mbind, p, len, SKETCH_MPOL_BIND, &mask, 64 + 1, 0) == 0)
+				node = policy.numa_node;
+		}
+
+		SketchAllocHeader *h = (SketchAllocHeader *)start;
+		h->base = p, h->map_size = len, h->pages = pages, h->numa_node = node;
+		return h + 1;
+	}
+	throw std::bad_alloc();
+}
+
+static inline void sketch_free(void *p)
+{
+	if (!p)
+		return;
+	SketchAllocHeader *h = sketch_alloc_header(p);
+	if (h->map_size)
+		munmap(h->base, h->map_size);
+	else
+		free(h->base);
+}
+
+// the SketchPages p was backed with
+static inline int sketch_alloc_pages(void *p)
+{
+	return sketch_alloc_header(p)->pages;
+}
+
+static inline int sketch_alloc_numa_node(void *p)
+{
+	return sketch_alloc_header(p)->numa_node;
+}
+
+#endif
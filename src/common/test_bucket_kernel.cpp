@@ -0,0 +1,48 @@
+// Checks every bucket_match_min kernel the CPU supports against the scalar
+// one on random buckets. Build without -mavx2 so all kernels are reachable:
+//   g++ -O2 -std=c++14 -o test_bucket_kernel test_bucket_kernel.cpp
+#include <iostream>
+#include <random>
+#include "bucket_kernel.h"
+
+int main() {
+    struct { const char *name; bool supported; bucket_match_min_t kernel; } kernels[] = {
+        {"sse41", __builtin_cpu_supports("sse4.1") != 0, bucket_match_min_sse41},
+        {"avx2", __builtin_cpu_supports("avx2") != 0, bucket_match_min_avx2},
+        {"avx512", __builtin_cpu_supports("avx512f") != 0, bucket_match_min_avx512},
+    };
+
+    std::mt19937 rng(1);
+    alignas(64) uint32_t bucket[2 * BUCKET_KERNEL_SLOTS];
+    int failed = 0;
+
+    for (int round = 0; round < 1000000; ++round) {
+        // small ranges so that matches, ties, empty slots and set high bits all show up
+        for (int i = 0; i < BUCKET_KERNEL_SLOTS; ++i) {
+            bucket[i] = rng() % 16;
+            bucket[BUCKET_KERNEL_SLOTS + i] = (rng() % 8) | ((rng() & 1) << 31);
+        }
+        uint32_t fp = rng() % 24;
+
+        int ref_min_counter = -1;
+        uint32_t ref_min_val = 0;
+        int ref = bucket_match_min_scalar(bucket, fp, ref_min_counter, ref_min_val);
+
+        for (auto &k : kernels) {
+            if (!k.supported)
+                continue;
+            int min_counter = -1;
+            uint32_t min_val = 0;
+            int res = k.kernel(bucket, fp, min_counter, min_val);
+            if (res != ref || (ref < 0 && (min_counter != ref_min_counter || min_val != ref_min_val))) {
+                if (failed++ < 10)
+                    std::cout << k.name << " differs from scalar in round " << round << "\n";
+            }
+        }
+    }
+
+    for (auto &k : kernels)
+        std::cout << k.name << (k.supported ? " checked\n" : " not supported by this CPU\n");
+    std::cout << (failed ? "FAILED" : "OK") << "\n";
+    return failed != 0;
+}
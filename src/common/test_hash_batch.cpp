@@ -0,0 +1,60 @@
+// Checks the batch hash kernels the CPU supports against BOBHash32::run and
+// the scalar MurmurHash3 on random keys of every length up to 40 bytes, high
+// bytes and odd counts included:
+//   g++ -O2 -std=c++14 -o test_hash_batch test_hash_batch.cpp
+#include <iostream>
+#include <random>
+#include <vector>
+#include "hash_batch.h"
+
+int main() {
+    std::mt19937 rng(1);
+    int failed = 0;
+
+    for (auto &k : hash_batch_kernels) {
+        if (!hash_batch_supported(k)) {
+            std::cout << k.name << " not supported by this CPU\n";
+            continue;
+        }
+        for (int round = 0; round < 2000; ++round) {
+            int key_len = 1 + round % 40;
+            size_t stride = key_len + rng() % 3;
+            if (round % 7 == 0 && key_len == 4)
+                stride = 4;
+            size_t n = rng() % 70;
+            std::vector<uint8_t> keys(n * stride + 1);
+            for (auto &b : keys)
+                b = (uint8_t)rng();
+            uint32_t prime_index = rng() % MAX_PRIME32, seed = rng();
+
+            std::vector<uint32_t> seeds(n), prime_indexes(n), out(n);
+            for (size_t i = 0; i < n; ++i) {
+                seeds[i] = rng();
+                prime_indexes[i] = rng() % MAX_PRIME32;
+            }
+
+            k.bob_batch(keys.data(), n, stride, key_len, prime_index, out.data());
+            for (size_t i = 0; i < n; ++i)
+                if (out[i] != BOBHash32(prime_index).run((const char *)&keys[i * stride], key_len) && failed++ < 10)
+                    std::cout << k.name << " bob_batch differs, key_len " << key_len << " stride " << stride << "\n";
+
+            k.murmur_batch(keys.data(), n, stride, key_len, seed, out.data());
+            for (size_t i = 0; i < n; ++i)
+                if (out[i] != murmur3_32(&keys[i * stride], key_len, seed) && failed++ < 10)
+                    std::cout << k.name << " murmur_batch differs, key_len " << key_len << " stride " << stride << "\n";
+
+            k.bob_seeds(keys.data(), key_len, prime_indexes.data(), n, out.data());
+            for (size_t i = 0; i < n; ++i)
+                if (out[i] != BOBHash32(prime_indexes[i]).run((const char *)keys.data(), key_len) && failed++ < 10)
+                    std::cout << k.name << " bob_seeds differs, key_len " << key_len << "\n";
+
+            k.murmur_seeds(keys.data(), key_len, seeds.data(), n, out.data());
+            for (size_t i = 0; i < n; ++i)
+                if (out[i] != murmur3_32(keys.data(), key_len, seeds[i]) && failed++ < 10)
+                    std::cout << k.name << " murmur_seeds differs, key_len " << key_len << "\n";
+        }
+        std::cout << k.name << " checked\n";
+    }
+    std::cout << (failed ? "FAILED" : "OK") << "\n";
+    return failed != 0;
+}
@@ -0,0 +1,88 @@
+// Round-trips random buckets through both snapshot encodings and checks that
+// bucket_merge keeps every count (in a slot or evicted) and the largest ones:
+//   g++ -O2 -std=c++14 -o test_sketch_snapshot test_sketch_snapshot.cpp
+#include <iostream>
+#include <random>
+#include <map>
+#include "sketch_snapshot.h"
+
+#define SLOTS 8
+#define VALID 7
+
+int main() {
+    std::mt19937 rng(1);
+    int failed = 0;
+
+    for (int round = 0; round < 1000; ++round) {
+        // small keys so that the two buckets of a merge share some
+        uint32_t a[2 * SLOTS], b[2 * SLOTS], c[2 * SLOTS];
+        for (uint32_t *bucket : {a, b}) {
+            for (int i = 0; i < SLOTS; ++i) {
+                bucket[i] = rng() % 16;
+                bucket[SLOTS + i] = rng() % 4 == 0 ? 0 : rng() >> (rng() % 32);
+            }
+            for (int i = 0; i < VALID; ++i)     // keys are unique in a bucket
+                for (int j = 0; j < i; ++j)
+                    if (bucket[SLOTS + i] && bucket[SLOTS + j] && bucket[i] == bucket[j])
+                        bucket[SLOTS + i] = 0;
+            for (int i = 0; i < SLOTS; ++i)     // empty slots have key 0
+                if (bucket[SLOTS + i] == 0)
+                    bucket[i] = 0;
+        }
+
+        for (int encoding : {SNAPSHOT_RAW, SNAPSHOT_VARINT}) {
+            std::vector<uint8_t> out;
+            snapshot_begin(out, SNAPSHOT_2FA, encoding, 1, 1, SLOTS, 0);
+            snapshot_put_buckets(out, a, 1, SLOTS, encoding);
+            snapshot_finish(out);
+            const uint8_t *p = out.data() + sizeof(SnapshotHeader);
+            if (!snapshot_check(out.data(), out.size(), SNAPSHOT_2FA, 1, SLOTS)
+                || !snapshot_get_buckets(p, out.data() + out.size(), c, 1, SLOTS, encoding)
+                || memcmp(a, c, sizeof(a)) != 0 || p != out.data() + out.size()) {
+                std::cout << "round " << round << ": encoding " << encoding << " does not round-trip" << std::endl;
+                failed++;
+            }
+        }
+
+        // a raw snapshot cut short, with a header that still matches its
+        // length, must be rejected before anything maps it in place
+        {
+            std::vector<uint8_t> out;
+            snapshot_begin(out, SNAPSHOT_2FA, SNAPSHOT_RAW, 1, 1, SLOTS, 0);
+            snapshot_put_buckets(out, a, 1, SLOTS, SNAPSHOT_RAW);
+            out.resize(out.size() - 1 - rng() % (2 * SLOTS * sizeof(uint32_t)));
+            snapshot_finish(out);
+            if (snapshot_check(out.data(), out.size(), SNAPSHOT_2FA, 1, SLOTS)) {
+                std::cout << "round " << round << ": truncated raw snapshot accepted" << std::endl;
+                failed++;
+            }
+        }
+
+        std::map<uint32_t, uint64_t> expected, got;
+        for (uint32_t *bucket : {a, b})
+            for (int i = 0; i < VALID; ++i)
+                if (bucket[SLOTS + i])
+                    expected[bucket[i]] += bucket[SLOTS + i];
+        uint32_t min_kept = UINT32_MAX, max_evicted = 0;
+        memcpy(c, a, sizeof(a));
+        bucket_merge(c, c + SLOTS, b, b + SLOTS, VALID, 0xFFFFFFFF, [&](uint32_t key, uint32_t val) {
+            got[key] += val;
+            max_evicted = std::max(max_evicted, val);
+        });
+        for (int i = 0; i < VALID; ++i)
+            if (c[SLOTS + i]) {
+                got[c[i]] += c[SLOTS + i];
+                min_kept = std::min(min_kept, c[SLOTS + i]);
+            }
+        // the counters are random 32-bit values, compare them modulo 2^32
+        for (auto &kv : expected)
+            kv.second = (uint32_t)kv.second;
+        if (got != expected || (max_evicted > 0 && max_evicted > min_kept)) {
+            std::cout << "round " << round << ": merge lost counts or evicted a larger counter" << std::endl;
+            failed++;
+        }
+    }
+
+    std::cout << (failed ? "FAILED" : "all snapshot checks passed") << std::endl;
+    return failed != 0;
+}
@@ -6,13 +6,14 @@
 #include <vector>
 #include<algorithm>
 #include "../2FASketch/2FASketch.h"
+#include "../common/trace_reader.h"
 #include "dataset_param.h"
 using namespace std;
 
 
 
 struct FIVE_TUPLE{	char key[13];	};
-typedef vector<FIVE_TUPLE> TRACE;
+typedef MappedTrace<FIVE_TUPLE> TRACE;
 TRACE traces[END_FILE_NO  + 1];
 
 void ReadInTraces(const char *trace_prefix)
@@ -34,15 +35,11 @@ void ReadInTraces(const char *trace_prefix)
 		#endif
 
 		
-		FILE *fin = fopen(datafileName, "rb");
-
-		FIVE_TUPLE tmp_five_tuple;
-		traces[datafileCnt-1].clear();
-		while(fread(&tmp_five_tuple, 1, 13, fin) == 13)
+		if(!traces[datafileCnt-1].open(datafileName))
 		{
-			traces[datafileCnt-1].push_back(tmp_five_tuple);
+			printf("cannot open %s\n", datafileName);
+			exit(1);
 		}
-		fclose(fin);
 
 	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
 
@@ -69,7 +66,7 @@ int main(int argc,char* argv[])
 #define HEAVY_MEM (MEMORY_NUMBER/4 * 1024)
 #define BUCKET_NUM (HEAVY_MEM / 64)
 #define TOT_MEM_IN_BYTES (MEMORY_NUMBER * 1024)
-#define TOT_BUCKET_NUM (TOT_MEM_IN_BYTES/64)
+#define TOT_BUCKET_NUM (TOT_MEM_IN_BYTES/sizeof(Bucket))
 	Elastic_2FASketch<TOT_BUCKET_NUM> *E_2FA = NULL;
 	fout.open(argv[1],ios::app);
 	double average_ARE=0,average_AAE=0;
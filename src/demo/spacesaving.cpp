@@ -6,13 +6,14 @@
 #include <vector>
 #include<algorithm>
 #include "../SpaceSaving/SpaceSaving.h"
+#include "../common/trace_reader.h"
 #include "dataset_param.h"
 using namespace std;
 
 
 
 struct FIVE_TUPLE{	char key[13];	};
-typedef vector<FIVE_TUPLE> TRACE;
+typedef MappedTrace<FIVE_TUPLE> TRACE;
 TRACE traces[END_FILE_NO  + 1];
 
 void ReadInTraces(const char *trace_prefix)
@@ -35,14 +36,11 @@ void ReadInTraces(const char *trace_prefix)
     		printf("processing zipf synthetic dataset with skewness %.1f for file %s...\n", z_alpha, datafileName);
 		#endif
 		
-		FILE *fin = fopen(datafileName, "rb");
-		FIVE_TUPLE tmp_five_tuple;
-		traces[datafileCnt - 1].clear();
-		while(fread(&tmp_five_tuple, 1, 13, fin) == 13)
+		if(!traces[datafileCnt - 1].open(datafileName))
 		{
-			traces[datafileCnt - 1].push_back(tmp_five_tuple);
+			printf("cannot open %s\n", datafileName);
+			exit(1);
 		}
-		fclose(fin);
 
 		printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt - 1].size());
 		}
@@ -12,14 +12,14 @@ class LightPart
 
 public:
 	uint8_t counters[counter_num];
-	int mice_dist[256];
-	EMFSD *em_fsd_algo = NULL;
+	EMFSD em_fsd_algo;	// kept for its cached combinations and warm starts
+	uint32_t seed;	// prime index of bobhash
 
-	LightPart()
+	LightPart(uint32_t seed = SKETCH_RANDOM_SEED)
 	{
 		clear();
-		std::random_device rd;
-       	bobhash = new BOBHash32(rd() % MAX_PRIME32);
+		this->seed = sketch_seed(seed);
+		bobhash = new BOBHash32(this->seed);
 	}
 	~LightPart()
 	{
@@ -29,7 +29,6 @@ public:
 	void clear()
 	{
 		memset(counters, 0, counter_num);
-		memset(mice_dist, 0, sizeof(int) * 256);
 	}
 
 
@@ -39,14 +38,10 @@ public:
 		uint32_t hash_val = (uint32_t)bobhash->run((const char*)key, KEY_LENGTH_4);
 		uint32_t pos = hash_val % (uint32_t)counter_num;
 
-		int old_val = (int)counters[pos];
         int new_val = (int)counters[pos] + f;
 
         new_val = new_val < 255 ? new_val : 255;
         counters[pos] = (uint8_t)new_val;
-
-        mice_dist[old_val]--;
-        mice_dist[new_val]++;
 	}
 
 	void swap_insert(uint8_t *key, int f)
@@ -56,14 +51,7 @@ public:
 
         f = f < 255 ? f : 255;
         if (counters[pos] < f) 
-        {
-            int old_val = (int)counters[pos];
             counters[pos] = (uint8_t)f;
-            int new_val = (int)counters[pos];
-
-			mice_dist[old_val]--;
-			mice_dist[new_val]++;
-		}
 	}
 
 
@@ -77,18 +65,51 @@ public:
     }
 
 
+/* snapshots */
+	void set_seed(uint32_t seed)
+	{
+		this->seed = sketch_seed(seed);
+		bobhash->initialize(this->seed);
+	}
+
+	// adds the counters of other, which has the same seed, saturating at 255
+	void merge(const LightPart &other)
+	{
+		for (int i = 0; i < counter_num; ++i)
+		{
+			int val = (int)counters[i] + other.counters[i];
+			counters[i] = (uint8_t)(val < 255 ? val : 255);
+		}
+	}
+
+
 /* compress */
+	// dst[i] is the max of counters i, i + width, i + 2 * width, ...: the
+	// counters are taken a row of width at a time and maxed into dst, 32
+	// bytes per _mm256_max_epu8, so both are read sequentially
     void compress(int ratio, uint8_t *dst) 
     {
 		int width = get_compress_width(ratio);
+		if (width <= 0)
+			return;
 
-		for (int i = 0; i < width && i < counter_num; ++i) 
+		memcpy(dst, counters, width);
+		for (int row = width; row < counter_num; row += width)
 		{
-			uint8_t max_val = 0;
-			for (int j = i; j < counter_num; j += width)
-                	max_val = counters[j] > max_val ? counters[j] : max_val;
-			dst[i] = max_val;
-        }
+			const uint8_t *src = counters + row;
+			int len = counter_num - row < width ? counter_num - row : width;
+			int i = 0;
+#ifdef __AVX2__
+			for (; i + 32 <= len; i += 32)
+			{
+				__m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+				__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+				_mm256_storeu_si256((__m256i *)(dst + i), _mm256_max_epu8(a, b));
+			}
+#endif
+			for (; i < len; ++i)
+				dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+		}
     }
 
 	int query_compressed_part(uint8_t *key, uint8_t *compress_part, int compress_counter_num) 
@@ -99,24 +120,75 @@ public:
         return (int)compress_part[pos];
     }
 
+	// query_compressed_part of n keys of stride bytes into results: the
+	// positions of a run of keys are hashed first and their counters
+	// prefetched, then read
+	void query_compressed_batch(const uint8_t *keys, size_t n, size_t stride, const uint8_t *compress_part,
+								int compress_counter_num, int *results)
+	{
+		uint32_t poses[QUERY_BATCH];
+		for (size_t base = 0; base < n; base += QUERY_BATCH)
+		{
+			size_t m = n - base < QUERY_BATCH ? n - base : QUERY_BATCH;
+			for (size_t i = 0; i < m; ++i)
+			{
+				uint32_t hash_val = (uint32_t)bobhash->run((const char *)(keys + (base + i) * stride), KEY_LENGTH_4);
+				poses[i] = (hash_val % (uint32_t)counter_num) % compress_counter_num;
+				_mm_prefetch((const char *)&compress_part[poses[i]], _MM_HINT_T0);
+			}
+			for (size_t i = 0; i < m; ++i)
+				results[base + i] = (int)compress_part[poses[i]];
+		}
+	}
+
 
 /* other measurement task */
+	// Histogram of the counter values. It is not kept up to date on insert,
+	// which would cost two dependent random writes per packet, but counted
+	// here from the counters, 8 at a time into 4 tables so that runs of
+	// equal values do not wait on each other's increments.
+	void get_mice_dist(int mice_dist[256])
+	{
+		int part[4][256];
+		memset(part, 0, sizeof(part));
+		int i = 0;
+		for (; i + 8 <= counter_num; i += 8)
+		{
+			uint64_t w;
+			memcpy(&w, counters + i, 8);
+			part[0][w & 0xFF]++;
+			part[1][(w >> 8) & 0xFF]++;
+			part[2][(w >> 16) & 0xFF]++;
+			part[3][(w >> 24) & 0xFF]++;
+			part[0][(w >> 32) & 0xFF]++;
+			part[1][(w >> 40) & 0xFF]++;
+			part[2][(w >> 48) & 0xFF]++;
+			part[3][w >> 56]++;
+		}
+		for (; i < counter_num; ++i)
+			part[0][counters[i]]++;
+		for (int v = 0; v < 256; ++v)
+			mice_dist[v] = part[0][v] + part[1][v] + part[2][v] + part[3][v];
+	}
+
+
     int get_compress_width(int ratio) { return (counter_num / ratio); }
     int get_compress_memory(int ratio) {	return (uint32_t)(counter_num / ratio); }
     int get_memory_usage() { return counter_num; }
 
    	int get_cardinality() 
    	{
-		int mice_card = 0;
-        for (int i = 1; i < 256; i++)
-			mice_card += mice_dist[i];
+		int mice_dist[256];
+		get_mice_dist(mice_dist);
 
-		double rate = (counter_num - mice_card) / (double)counter_num;
+		double rate = mice_dist[0] / (double)counter_num;
 		return counter_num * log(1 / rate);
     }
 
     void get_entropy(int &tot, double &entr)
     {
+		int mice_dist[256];
+		get_mice_dist(mice_dist);
         for (int i = 1; i < 256; i++) 
         {
             tot += mice_dist[i] * i;
@@ -124,27 +196,12 @@ public:
 		}
     }
 
-    void get_distribution(vector<double> &dist) 
+    // warm_start: begin from the previous estimate, see EMFSD::set_counters
+    void get_distribution(vector<double> &dist, bool warm_start = false) 
     {
-		uint32_t tmp_counters[counter_num];
-		for (int i = 0; i < counter_num; i++)
-			tmp_counters[i] = counters[i];
-
-        em_fsd_algo = new EMFSD();
-        em_fsd_algo->set_counters(counter_num, tmp_counters);
-
-        em_fsd_algo->next_epoch();
-        em_fsd_algo->next_epoch();
-       	em_fsd_algo->next_epoch();
-     	em_fsd_algo->next_epoch();
-     	em_fsd_algo->next_epoch();
-      	em_fsd_algo->next_epoch();
-       	em_fsd_algo->next_epoch();
-     	em_fsd_algo->next_epoch();
-   		em_fsd_algo->next_epoch();
-        em_fsd_algo->next_epoch();
-
-        dist = em_fsd_algo->ns;
+        em_fsd_algo.set_counters(counter_num, counters, warm_start);
+        em_fsd_algo.run();
+        dist = em_fsd_algo.ns;
     }
 };
 
@@ -2,54 +2,74 @@
 #define _2FASketch_speed_H_
 
 #include "HeavyPart.h"
+#include "LightPart.h"
 
 
-
-template<int bucket_num>
+// light_mem bytes of 8-bit counters, see LightPart.h, take what the heavy
+// part lets go of. With light_mem == 0 (the default) only the heavy part is
+// kept and the cardinality, entropy and distribution are those of its flows.
+template<int bucket_num, int light_mem = 0>
 class Elastic_2FASketch
 {
     static constexpr int heavy_mem = bucket_num * COUNTER_PER_BUCKET * 8;
- //   static constexpr int light_mem = tot_memory_in_bytes - heavy_mem;
-    
 
     Elastic_2FA_HeavyPart<bucket_num> heavy_part;
- //   LightPart<light_mem> light_part;
+    Elastic_2FA_LightPart<light_mem> light_part;
     int thres_set;
 
 public:
-    Elastic_2FASketch(int thres_set): thres_set(thres_set){}
+    // sketches to be merged must share a seed, see common/sketch_snapshot.h
+    Elastic_2FASketch(int thres_set, uint32_t seed = SKETCH_RANDOM_SEED)
+        : heavy_part(seed), light_part(heavy_part.seed), thres_set(thres_set){}
     ~Elastic_2FASketch(){}
     void clear()
     {
         heavy_part.clear();
-  //      light_part.clear();
+        light_part.clear();
     }
 
     void insert(uint8_t *key, int f = 1)
     {
-        /*uint8_t swap_key[KEY_LENGTH_4];
-        uint32_t swap_val = 0;
-        int result = heavy_part.insert(key, swap_key, swap_val, f);
+        if(light_mem == 0)
+        {
+            int res =  heavy_part.quick_insert(key, f, thres_set);
+            if(res == thres_set) {heavy_part.quick_insert(key, f);}
+            return;
+        }
+
+        uint32_t swap_key, swap_val;
+        int res = heavy_part.quick_insert(key, f, thres_set, swap_key, swap_val);
+        if(res == thres_set)
+            res = heavy_part.quick_insert(key, f, 0, swap_key, swap_val);
 
-        switch(result)
+        switch(res)
         {
-            case 0: return;
-            case 1:{
-                if(HIGHEST_BIT_IS_1(swap_val))
-                    light_part.insert(swap_key, GetCounterVal(swap_val));
-                else
-                    light_part.swap_insert(swap_key, swap_val);
-                return;
-            }
-            case 2: light_part.insert(key, 1);  return;
-            default:
-                printf("error return value !\n");
-                exit(1);
+            case 1: light_part.swap_insert((uint8_t*)&swap_key, swap_val); return;
+            case 2: light_part.insert(key, f); return;
         }
-        */
-        
-        int res =  heavy_part.quick_insert(key, f, thres_set);
-        if(res == thres_set) {heavy_part.quick_insert(key, f);}
+    }
+
+    // keys: n records of stride bytes, e.g. a FIVE_TUPLE array with stride 13.
+    // Light part updates are gathered and applied LIGHT_BATCH at a time.
+    void insert_batch(const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        if(light_mem == 0)
+        {
+            heavy_part.insert_batch(keys, n, stride, f, thres_set);
+            return;
+        }
+
+        LightItem spilled[LIGHT_BATCH];
+        size_t num = 0;
+        heavy_part.insert_batch(keys, n, stride, f, thres_set, [&](uint32_t key, uint32_t val, bool swapped) {
+            spilled[num++] = LightItem{key, val, swapped};
+            if(num == LIGHT_BATCH)
+            {
+                light_part.insert_batch(spilled, num);
+                num = 0;
+            }
+        });
+        light_part.insert_batch(spilled, num);
     }
 
     void quick_insert(uint8_t *key, int f = 1)
@@ -58,94 +78,114 @@ public:
         if(res == thres_set) {cout << "res "; heavy_part.quick_insert(key, f);}
     }
 
+    // the heavy part count, or the light part one for a key it does not hold
     int query(uint8_t *key)
     {
         uint32_t heavy_result = heavy_part.query(key, thres_set);
-     //   if(heavy_result == 0 || HIGHEST_BIT_IS_1(heavy_result))
-       // {
-        //    int light_result = light_part.query(key);
-        //    return (int)GetCounterVal(heavy_result) + light_result;
-      //  }
+        if(heavy_result == 0)
+            return light_part.query(key);
         return heavy_result;
     }
 
-   /* int query_compressed_part(uint8_t *key, uint8_t *compress_part, int compress_counter_num)
+    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
     {
-        uint32_t heavy_result = heavy_part.query(key);
-        if(heavy_result == 0 || HIGHEST_BIT_IS_1(heavy_result))
-        {
-            int light_result = light_part.query_compressed_part(key, compress_part, compress_counter_num);
-            return (int)GetCounterVal(heavy_result) + light_result;
-        }
-        return heavy_result;
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            results.push_back(make_pair(string((const char*)&key, 4), count));
+        });
     }
-*/
-    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
+
+    // calls visit(key, count) for every heavy hitter, key being the 4-byte
+    // flow key; nothing is allocated
+    template<typename Visitor>
+    void for_each_heavy_hitter(int threshold, Visitor &&visit)
     {
-        std::unordered_map<string, int> ground;
-        for (int i = 0; i < bucket_num; ++i) 
-            for (int j = 0; j < MAX_VALID_COUNTER; ++j) 
+        heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+    // writes up to capacity heavy hitters to keys/counts and returns how many
+    // there are, so a caller whose buffer was too small can retry
+    size_t get_heavy_hitters(int threshold, uint32_t *keys, int *counts, size_t capacity)
+    {
+        size_t num = 0;
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            if (num < capacity)
             {
-                uint32_t key = heavy_part.buckets[i].key[j];
-                int val = heavy_part.buckets[i].val[j];
-                ground[string((const char*)&key, 4)] += val;
-                // cout << "node: " << key << " " << val << endl;
-                
+                keys[num] = key;
+                counts[num] = count;
             }
-        for (auto it = ground.begin(); it != ground.end();)
-		{
-			if (it->second < threshold)
-			{
-				it = ground.erase(it);
-			}
-			else
-				it++;
-		}
-        for (auto it = ground.begin(); it != ground.end(); it++)
-		{
-			std::pair<string, int> node;
-			node.first = it->first; // memcpy(key, it->first.key, key_len);
-			node.second = it->second;
-			results.push_back(node);
-		}
+            num++;
+        });
+        return num;
+    }
+
+/* snapshots, see common/sketch_snapshot.h; the light part counters, if any,
+   follow the buckets */
+    void serialize(vector<uint8_t> &out, int encoding = SNAPSHOT_RAW)
+    {
+        snapshot_begin(out, SNAPSHOT_2FA, encoding, heavy_part.seed, bucket_num, COUNTER_PER_BUCKET, thres_set, light_mem);
+        snapshot_put_buckets(out, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, encoding);
+        out.insert(out.end(), light_part.counters, light_part.counters + light_mem);
+        snapshot_finish(out);
+    }
+
+    // false if data is not a snapshot of a 2FASketch of this size; the seed
+    // and thres_set are taken from the snapshot
+    bool deserialize(const uint8_t *data, size_t len)
+    {
+        const SnapshotHeader *h = snapshot_check(data, len, SNAPSHOT_2FA, bucket_num, COUNTER_PER_BUCKET);
+        if(!h || h->light_bytes != light_mem)
+            return false;
+        const uint8_t *p = data + sizeof(SnapshotHeader), *end = data + len;
+        clear();
+        if(!snapshot_get_buckets(p, end, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, h->encoding) || end - p != light_mem)
+        {
+            clear();
+            return false;
+        }
+        if(light_mem)
+            memcpy(light_part.counters, p, light_mem);
+        heavy_part.set_seed(h->seed);
+        light_part.set_seed(heavy_part.seed);
+        thres_set = h->thres_set;
+        return true;
+    }
+
+    // Adds the counts of other; false if it has another seed. Heavy counters
+    // that no longer fit in their bucket go to the light part, as on a swap.
+    bool merge(const Elastic_2FASketch &other)
+    {
+        if(other.heavy_part.seed != heavy_part.seed)
+            return false;
+        light_part.merge(other.light_part);
+        heavy_part.merge(other.heavy_part, [&](uint32_t key, uint32_t val) {
+            light_part.swap_insert((uint8_t*)&key, val);
+        });
+        return true;
     }
 
+    uint32_t get_seed() { return heavy_part.seed; }
+
 /* interface */
- //   int get_compress_width(int ratio) { return light_part.get_compress_width(ratio);}
-  //  void compress(int ratio, uint8_t *dst) {    light_part.compress(ratio, dst); }
     int get_bucket_num() { return heavy_part.get_bucket_num(); }
+    int get_memory_usage() { return heavy_part.get_memory_usage() + light_part.get_memory_usage(); }
 
     double get_cnt_ratio(){ return heavy_part.cnt / (double) heavy_part.cnt_all;}
     int get_cnt(){ return heavy_part.cnt_all;}
-    /*
-    double get_bandwidth(int compress_ratio) 
-    {
-        int result = heavy_part.get_memory_usage();
-        result += get_compress_width(compress_ratio) * sizeof(uint8_t);
-        return result * 1.0 / 1024 / 1024;
-    }
-    */
-/*
+
+/* measurement: the light part estimate plus the heavy part flows. A swapped
+   in key starts from the guard count, which stands for its packets turned
+   away before, so its counter replaces its light counter instead of adding
+   to it. Other heavy keys never reached the light part, and a nonzero light
+   counter there belongs to colliding mice. */
     int get_cardinality()
     {
         int card = light_part.get_cardinality();
-        for(int i = 0; i < bucket_num; ++i)
-            for(int j = 0; j < MAX_VALID_COUNTER; ++j)
-            {
-                uint8_t key[KEY_LENGTH_4];
-                *(uint32_t*)key = heavy_part.buckets[i].key[j];
-                int val = heavy_part.buckets[i].val[j];
-                int ex_val = light_part.query(key);
-
-                if(HIGHEST_BIT_IS_1(val) && ex_val)
-                {
-                    val += ex_val;
-                    card--;
-                }
-                if(GetCounterVal(val))
-                    card++;
-            }
-            return card;
+        for_each_heavy_counter([&](int val, int ex_val) {
+            if(ex_val)
+                card--;
+            card++;
+        });
+        return card;
     }
 
     double get_entropy()
@@ -154,78 +194,55 @@ public:
         double entr = 0;
 
         light_part.get_entropy(tot, entr);
-
-        for(int i = 0; i < bucket_num; ++i)
-            for(int j = 0; j < MAX_VALID_COUNTER; ++j)
+        for_each_heavy_counter([&](int val, int ex_val) {
+            if(ex_val)
             {
-                uint8_t key[KEY_LENGTH_4];
-                *(uint32_t*)key = heavy_part.buckets[i].key[j];
-                int val = heavy_part.buckets[i].val[j];
-
-                int ex_val = light_part.query(key);
-
-                if(HIGHEST_BIT_IS_1(val) && ex_val)
-                {
-                    val += ex_val;
-
-                    tot -= ex_val;
-
-                    entr -= ex_val * log2(ex_val);
-                }
-                val = GetCounterVal(val);
-                if(val)
-                {
-                    tot += val;
-                    entr += val * log2(val);
-                }
+                tot -= ex_val;
+                entr -= ex_val * log2(ex_val);
             }
+            tot += val;
+            entr += val * log2(val);
+        });
         return -entr / tot + log2(tot);
     }
 
-    void get_distribution(vector<double> &dist)
+    void get_distribution(vector<double> &dist, bool warm_start = false)
     {
-        light_part.get_distribution(dist);
-
-        for(int i = 0; i < bucket_num; ++i)
-            for(int j = 0; j < MAX_VALID_COUNTER; ++j)
-            {
-                uint8_t key[KEY_LENGTH_4];
-                *(uint32_t*)key = heavy_part.buckets[i].key[j];
-                int val = heavy_part.buckets[i].val[j];
-
-                int ex_val = light_part.query(key);
-
-                if(HIGHEST_BIT_IS_1(val) && ex_val != 0)
-                {
-                    val += ex_val;
-                    dist[ex_val]--;
-                }
-                val = GetCounterVal(val);
-                if(val)
-                {
-                    if(val + 1 > dist.size())
-                        dist.resize(val + 1);
-                    dist[val]++;
-                }
-            }
+        light_part.get_distribution(dist, warm_start);
+        for_each_heavy_counter([&](int val, int ex_val) {
+            if(ex_val && ex_val < (int)dist.size())
+                dist[ex_val]--;
+            if(val + 1 > (int)dist.size())
+                dist.resize(val + 1);
+            dist[val]++;
+        });
     }
-*/
+
+    // see common/sketch_alloc.h for hugepages and NUMA binding
     void *operator new(size_t sz)
     {
-        constexpr uint32_t alignment = 64;
-        size_t alloc_size = (2 * alignment + sz) / alignment * alignment;
-        void *ptr = ::operator new(alloc_size);
-        void *old_ptr = ptr;
-        void *new_ptr = ((char*)std::align(alignment, sz, ptr, alloc_size) + alignment);
-        ((void **)new_ptr)[-1] = old_ptr;
-
-        return new_ptr;
+        return sketch_alloc(sz);
     }
     void operator delete(void *p)
     {
-        ::operator delete(((void**)p)[-1]);
+        sketch_free(p);
     }
 
+private:
+    // visit(val, ex_val) for every nonzero heavy counter, ex_val being the
+    // light part counter of its key if it was swapped in, else 0
+    template<typename Visitor>
+    void for_each_heavy_counter(Visitor &&visit)
+    {
+        for(int i = 0; i < bucket_num; ++i)
+            for(int j = 0; j < MAX_VALID_COUNTER; ++j)
+            {
+                uint32_t key = heavy_part.buckets[i].key[j];
+                uint32_t val = heavy_part.buckets[i].val[j];
+                if(GetCounterVal(val))
+                    visit((int)GetCounterVal(val), HIGHEST_BIT_IS_1(val) ? light_part.query((uint8_t*)&key) : 0);
+            }
+    }
 };
 
 
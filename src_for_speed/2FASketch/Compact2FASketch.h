@@ -0,0 +1,85 @@
+#ifndef _COMPACT_2FASketch_H_
+#define _COMPACT_2FASketch_H_
+
+#include "CompactHeavyPart.h"
+#include <vector>
+
+// Elastic_2FASketch on 16-bit buckets, see CompactHeavyPart.h. Set
+// promote_at to at most the heavy hitter threshold: only promoted keys can
+// be reported.
+template<int bucket_num, int overflow_num>
+class Compact_2FASketch
+{
+    Compact_2FA_HeavyPart<bucket_num, overflow_num> heavy_part;
+    int thres_set;
+
+public:
+    Compact_2FASketch(int thres_set, uint32_t promote_at = COMPACT_MAX_VAL, uint32_t seed = SKETCH_RANDOM_SEED)
+        : heavy_part(promote_at, seed), thres_set(thres_set){}
+    ~Compact_2FASketch(){}
+    void clear()
+    {
+        heavy_part.clear();
+    }
+
+    void insert(uint8_t *key, int f = 1)
+    {
+        int res = heavy_part.quick_insert(key, f, thres_set);
+        if(res == thres_set) {heavy_part.quick_insert(key, f);}
+    }
+
+    void insert_batch(const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        heavy_part.insert_batch(keys, n, stride, f, thres_set);
+    }
+
+    int query(uint8_t *key)
+    {
+        return heavy_part.query(key, thres_set);
+    }
+
+    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            results.push_back(make_pair(string((const char*)&key, 4), count));
+        });
+    }
+
+    template<typename Visitor>
+    void for_each_heavy_hitter(int threshold, Visitor &&visit)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+    // see Elastic_2FASketch::get_heavy_hitters
+    size_t get_heavy_hitters(int threshold, uint32_t *keys, int *counts, size_t capacity)
+    {
+        size_t num = 0;
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            if (num < capacity)
+            {
+                keys[num] = key;
+                counts[num] = count;
+            }
+            num++;
+        });
+        return num;
+    }
+
+/* interface */
+    int get_bucket_num() { return heavy_part.get_bucket_num(); }
+    int get_memory_usage() { return heavy_part.get_memory_usage(); }
+    // keys promoted to the overflow table
+    int get_overflow_size() { return heavy_part.get_overflow_size(); }
+
+    void *operator new(size_t sz)
+    {
+        return sketch_alloc(sz);
+    }
+    void operator delete(void *p)
+    {
+        sketch_free(p);
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef _CONCURRENT_2FA_HEAVYPART_H_
+#define _CONCURRENT_2FA_HEAVYPART_H_
+
+#include "HeavyPart.h"
+
+// index of fp among the valid slots of bucket, -1 if absent; the key lane of
+// the guard is left out
+static inline int bucket_find_valid(const Bucket &bucket, uint32_t fp)
+{
+	const uint32_t valid = (1u << MAX_VALID_COUNTER) - 1;
+#ifdef BUCKET_AVX512
+	uint32_t matched = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(bucket.key), _mm512_set1_epi32((int)fp)) & valid;
+#elif defined(__AVX2__)
+	__m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)bucket.key), _mm256_set1_epi32((int)fp));
+	uint32_t matched = _mm256_movemask_ps(_mm256_castsi256_ps(eq)) & valid;
+#else
+	uint32_t matched = 0;
+	for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		if (bucket.key[i] == fp)
+			matched |= 1u << i;
+#endif
+	return matched ? __builtin_ctz(matched) : -1;
+}
+
+// Elastic_2FA_HeavyPart that many threads can update at once, for traffic
+// that cannot be sharded evenly (see Sharded2FASketch.h otherwise).
+//
+// The key lane of the guard, unused by the sequential heavy part, holds a
+// per-bucket sequence number, so the lock shares the bucket's cache line:
+//  - hit: the SIMD scan runs without the lock, and the counter is bumped
+//    with an atomic add. This is the common case for heavy flows and is
+//    wait-free.
+//  - miss: the bucket is locked by making its sequence odd with a CAS and
+//    scanned again. The empty-slot fill, backup redirect, guard increment
+//    or swap then runs as in bucket_quick_insert, and the sequence is made
+//    even again.
+//  - query: a seqlock read, retried while a writer holds the bucket.
+// A swap stores the new key before exchanging the counter. A hit on the
+// evicted key that lands before the exchange leaves with the evicted
+// counter. Only a hit whose scan predates the key store and whose add
+// comes after the exchange is credited to the new key, a window of a few
+// instructions per swap.
+template <int bucket_num>
+class Concurrent_2FA_HeavyPart
+{
+public:
+	alignas(64) Bucket buckets[bucket_num];
+	BOBHash32 *bobhash = NULL;
+	uint32_t seed;
+
+	Concurrent_2FA_HeavyPart(uint32_t seed = SKETCH_RANDOM_SEED)
+	{
+		clear();
+		this->seed = sketch_seed(seed);
+		bobhash = new BOBHash32(this->seed);
+	}
+	~Concurrent_2FA_HeavyPart()
+	{
+		delete bobhash;
+	}
+
+	// not thread-safe
+	void clear()
+	{
+		memset(buckets, 0, sizeof(Bucket) * bucket_num);
+	}
+
+	// thres_set != 0, first insert, == 0, second insert; thread-safe
+	int quick_insert(const uint8_t *key, uint32_t f = 1, uint32_t thres_set = 0)
+	{
+		uint32_t fp;
+		int pos = CalculateFP(key, fp, thres_set == 0);
+		return quick_insert_at(pos, fp, f, thres_set);
+	}
+
+	/* batched insertion, see Elastic_2FA_HeavyPart::insert_batch; thread-safe */
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set)
+	{
+		uint32_t fps[BATCH_PREFETCH_DIST];
+		int poses[BATCH_PREFETCH_DIST];
+
+		size_t warm = n < BATCH_PREFETCH_DIST ? n : BATCH_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
+		{
+			poses[i] = CalculateFP(keys + i * stride, fps[i]);
+			prefetch_bucket(&buckets[poses[i]]);
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t slot = i & (BATCH_PREFETCH_DIST - 1);
+			uint32_t fp = fps[slot];
+			int pos = poses[slot];
+
+			size_t ahead = i + BATCH_PREFETCH_DIST;
+			if (ahead < n)
+			{
+				poses[slot] = CalculateFP(keys + ahead * stride, fps[slot]);
+				prefetch_bucket(&buckets[poses[slot]]);
+			}
+
+			int res = quick_insert_at(pos, fp, f, thres_set);
+			if (res == thres_set)
+				quick_insert(keys + i * stride, f);
+		}
+	}
+
+	/* query, see Elastic_2FA_HeavyPart::query; thread-safe */
+	uint32_t query(const uint8_t *key, int thres_set)
+	{
+		uint32_t fp;
+		Bucket bucket;
+		read_bucket(CalculateFP(key, fp), bucket);
+
+		uint32_t res = 0, min_cnt = UINT32_MAX;
+		for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		{
+			if (bucket.key[i] == fp)
+				res += bucket.val[i];
+			min_cnt = min(min_cnt, bucket.val[i]);
+		}
+		if (min_cnt >= (uint32_t)thres_set)
+		{
+			read_bucket(CalculateFP(key, fp, true), bucket);
+			res += bucket_counter_of(bucket, fp);
+		}
+		return res;
+	}
+
+	/* heavy hitters, see Elastic_2FA_HeavyPart::for_each_heavy_hitter; each
+	   bucket is read consistently, but concurrent inserts may move a key
+	   between the reads of its two buckets */
+	template <typename Visitor>
+	void for_each_heavy_hitter(int threshold, Visitor &&visit)
+	{
+		uint32_t half = threshold > 1 ? (threshold + 1) / 2 : 1;
+		Bucket bucket, other_bucket;
+		for (int i = 0; i < bucket_num; ++i)
+		{
+			read_bucket(i, bucket);
+			uint32_t mask = bucket_slots_at_least(bucket, half);
+			while (mask)
+			{
+				int j = __builtin_ctz(mask);
+				mask &= mask - 1;
+				uint32_t fp = bucket.key[j];
+				uint32_t val = bucket.val[j];
+
+				uint32_t k = fp;
+				int primary = CalculateFP((uint8_t *)&k, fp);
+				int backup = CalculateFP((uint8_t *)&k, fp, true);
+				int other = i == primary ? backup : (i == backup ? primary : i);
+				if (other != i)
+				{
+					read_bucket(other, other_bucket);
+					uint32_t other_val = bucket_counter_of(other_bucket, fp);
+					if (other_val >= half && other < i)
+						continue;
+					val += other_val;
+				}
+				if ((int)val >= threshold)
+					visit(fp, (int)val);
+			}
+		}
+	}
+
+	/* interface */
+	int get_memory_usage()
+	{
+		return bucket_num * sizeof(Bucket);
+	}
+	int get_bucket_num()
+	{
+		return bucket_num;
+	}
+
+private:
+	static uint32_t *seq_of(Bucket &bucket)
+	{
+		return &bucket.key[MAX_VALID_COUNTER];
+	}
+
+	// returns the (even) sequence the bucket had
+	static uint32_t lock(Bucket &bucket)
+	{
+		uint32_t *seq = seq_of(bucket);
+		while (true)
+		{
+			uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+			if (!(s & 1) && __atomic_compare_exchange_n(seq, &s, s + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				return s;
+			_mm_pause();
+		}
+	}
+
+	static void unlock(Bucket &bucket, uint32_t s)
+	{
+		__atomic_store_n(seq_of(bucket), s + 2, __ATOMIC_RELEASE);
+	}
+
+	// consistent copy of bucket pos, retried while a writer holds it
+	void read_bucket(int pos, Bucket &out)
+	{
+		uint32_t *seq = seq_of(buckets[pos]);
+		while (true)
+		{
+			uint32_t s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+			if (!(s & 1))
+			{
+				memcpy(&out, &buckets[pos], sizeof(Bucket));
+				__atomic_thread_fence(__ATOMIC_ACQUIRE);
+				if (__atomic_load_n(seq, __ATOMIC_RELAXED) == s)
+					return;
+			}
+			_mm_pause();
+		}
+	}
+
+	int quick_insert_at(int pos, uint32_t fp, uint32_t f, uint32_t thres_set)
+	{
+		Bucket &bucket = buckets[pos];
+		int matched_index = bucket_find_valid(bucket, fp);
+		if (matched_index >= 0)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
+			__atomic_fetch_add(&bucket.val[matched_index], f, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		uint32_t s = lock(bucket);
+		int res = locked_insert(bucket, fp, f, thres_set);
+		unlock(bucket, s);
+		return res;
+	}
+
+	// bucket_quick_insert with bucket locked; counters may still be
+	// incremented by hits
+	int locked_insert(Bucket &bucket, uint32_t fp, uint32_t f, uint32_t thres_set)
+	{
+		// another thread may have stored fp since the unlocked scan
+		int matched_index = bucket_find_valid(bucket, fp);
+		if (matched_index >= 0)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
+			__atomic_fetch_add(&bucket.val[matched_index], f, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		int min_counter = 0;
+		uint32_t min_counter_val = __atomic_load_n(&bucket.val[0], __ATOMIC_RELAXED);
+		for (int i = 1; i < MAX_VALID_COUNTER; ++i)
+		{
+			uint32_t v = __atomic_load_n(&bucket.val[i], __ATOMIC_RELAXED);
+			if (v < min_counter_val)
+			{
+				min_counter_val = v;
+				min_counter = i;
+			}
+		}
+
+		if (min_counter_val == 0)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_EMPTY);
+			__atomic_store_n(&bucket.key[min_counter], fp, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&bucket.val[min_counter], f, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		if (thres_set != 0 && min_counter_val > thres_set)
+		{
+			RECORD_INSERT_OUTCOME(INSERT_BACKUP);
+			return thres_set;
+		}
+
+		// the guard is only written with the bucket locked
+		uint32_t guard_val = UPDATE_GUARD_VAL(bucket.val[MAX_VALID_COUNTER]);
+		if (!JUDGE_IF_SWAP(min_counter_val, guard_val))
+		{
+			RECORD_INSERT_OUTCOME(INSERT_GUARD);
+			bucket.val[MAX_VALID_COUNTER] = guard_val;
+			return 2;
+		}
+
+		bucket.val[MAX_VALID_COUNTER] = 0;
+		__atomic_store_n(&bucket.key[min_counter], fp, __ATOMIC_RELAXED);
+		__atomic_exchange_n(&bucket.val[min_counter], guard_val, __ATOMIC_RELAXED);
+		RECORD_INSERT_OUTCOME(INSERT_SWAP);
+		return 1;
+	}
+
+	int CalculateFP(const uint8_t *key, uint32_t &fp, bool isBackup = false)
+	{
+		fp = *((const uint32_t *)key);
+		if (!isBackup)
+			return CalculateBucketPos(fp) % bucket_num;
+#ifdef BACKUP_SINGLE_HASH
+		return CalculateBucketPos2(fp) % bucket_num;
+#else
+		return bobhash->run((const char *)key, 4) % bucket_num;
+#endif
+	}
+};
+
+#endif
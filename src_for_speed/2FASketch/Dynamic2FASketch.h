@@ -0,0 +1,139 @@
+#ifndef _DYNAMIC_2FASketch_H_
+#define _DYNAMIC_2FASketch_H_
+
+#include "DynamicHeavyPart.h"
+#include <vector>
+
+// Elastic_2FASketch with the memory size chosen at runtime, so one binary
+// can sweep from a few KB to hundreds of MB.
+class Dynamic_2FASketch
+{
+    Dynamic_2FA_HeavyPart heavy_part;
+    int thres_set;
+
+public:
+    // throws std::invalid_argument if mem_in_bytes < sizeof(Bucket)
+    Dynamic_2FASketch(size_t mem_in_bytes, int thres_set, bool use_hugepage = false, uint32_t seed = SKETCH_RANDOM_SEED)
+        : heavy_part(mem_in_bytes / sizeof(Bucket), use_hugepage, seed), thres_set(thres_set){}
+    Dynamic_2FASketch(size_t mem_in_bytes, int thres_set, const SketchAllocPolicy &policy, uint32_t seed = SKETCH_RANDOM_SEED)
+        : heavy_part(mem_in_bytes / sizeof(Bucket), policy, seed), thres_set(thres_set){}
+    ~Dynamic_2FASketch(){}
+    void clear()
+    {
+        heavy_part.clear();
+    }
+
+    void insert(uint8_t *key, int f = 1)
+    {
+        int res =  heavy_part.quick_insert(key, f, thres_set);
+        if(res == thres_set) {heavy_part.quick_insert(key, f);}
+    }
+
+    // keys: n records of stride bytes, e.g. a FIVE_TUPLE array with stride 13
+    void insert_batch(const uint8_t *keys, size_t n, size_t stride, int f = 1)
+    {
+        heavy_part.insert_batch(keys, n, stride, f, thres_set);
+    }
+
+    int query(uint8_t *key)
+    {
+        return heavy_part.query(key, thres_set);
+    }
+
+    void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            results.push_back(make_pair(string((const char*)&key, 4), count));
+        });
+    }
+
+    // calls visit(key, count) for every heavy hitter, key being the 4-byte
+    // flow key; nothing is allocated
+    template<typename Visitor>
+    void for_each_heavy_hitter(int threshold, Visitor &&visit)
+    {
+        heavy_part.for_each_heavy_hitter(threshold, visit);
+    }
+
+    // writes up to capacity heavy hitters to keys/counts and returns how many
+    // there are, so a caller whose buffer was too small can retry
+    size_t get_heavy_hitters(int threshold, uint32_t *keys, int *counts, size_t capacity)
+    {
+        size_t num = 0;
+        heavy_part.for_each_heavy_hitter(threshold, [&](uint32_t key, int count) {
+            if (num < capacity)
+            {
+                keys[num] = key;
+                counts[num] = count;
+            }
+            num++;
+        });
+        return num;
+    }
+
+/* snapshots, see Elastic_2FASketch */
+    void serialize(vector<uint8_t> &out, int encoding = SNAPSHOT_RAW)
+    {
+        snapshot_begin(out, SNAPSHOT_2FA, encoding, heavy_part.seed, heavy_part.get_bucket_num(), COUNTER_PER_BUCKET, thres_set);
+        snapshot_put_buckets(out, heavy_part.buckets, heavy_part.get_bucket_num(), COUNTER_PER_BUCKET, encoding);
+        snapshot_finish(out);
+    }
+
+    bool deserialize(const uint8_t *data, size_t len)
+    {
+        const SnapshotHeader *h = snapshot_check(data, len, SNAPSHOT_2FA, heavy_part.get_bucket_num(), COUNTER_PER_BUCKET);
+        if(!h)
+            return false;
+        const uint8_t *p = data + sizeof(SnapshotHeader);
+        heavy_part.clear();
+        if(!snapshot_get_buckets(p, data + len, heavy_part.buckets, heavy_part.get_bucket_num(), COUNTER_PER_BUCKET, h->encoding))
+        {
+            heavy_part.clear();
+            return false;
+        }
+        heavy_part.set_seed(h->seed);
+        thres_set = h->thres_set;
+        return true;
+    }
+
+    // Zero-copy load of a SNAPSHOT_RAW file: the file is mapped copy-on-write
+    // and its bucket array used in place, so only the pages touched later
+    // are read or copied. False if the file is not a raw snapshot of this size.
+    bool load_mapped(const char *path)
+    {
+        size_t size;
+        uint8_t *data = snapshot_map(path, size, false);
+        if(!data)
+            return false;
+        const SnapshotHeader *h = snapshot_check(data, size, SNAPSHOT_2FA, heavy_part.get_bucket_num(), COUNTER_PER_BUCKET);
+        if(!h || h->encoding != SNAPSHOT_RAW)
+        {
+            munmap(data, size);
+            return false;
+        }
+        heavy_part.set_seed(h->seed);
+        thres_set = h->thres_set;
+        heavy_part.adopt_mapping(data, size, sizeof(SnapshotHeader));
+        return true;
+    }
+
+    bool merge(const Dynamic_2FASketch &other)
+    {
+        if(other.heavy_part.seed != heavy_part.seed || other.heavy_part.get_bucket_num() != heavy_part.get_bucket_num())
+            return false;
+        heavy_part.merge(other.heavy_part);
+        return true;
+    }
+
+    uint32_t get_seed() { return heavy_part.seed; }
+
+/* interface */
+    size_t get_bucket_num() { return heavy_part.get_bucket_num(); }
+    size_t get_memory_usage() { return heavy_part.get_memory_usage(); }
+    int get_pages() { return heavy_part.get_pages(); }
+
+    double get_cnt_ratio(){ return heavy_part.cnt / (double) heavy_part.cnt_all;}
+    int get_cnt(){ return heavy_part.cnt_all;}
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef _FIVE_TUPLE_2FA_HEAVYPART_H_
+#define _FIVE_TUPLE_2FA_HEAVYPART_H_
+
+#include "HeavyPart.h"
+
+// full key bytes kept per bucket, out of line
+#define FIVE_TUPLE_KEY_BYTES (MAX_VALID_COUNTER * KEY_LENGTH_13)
+// memory of one bucket together with its keys
+#define FIVE_TUPLE_BUCKET_BYTES (sizeof(Bucket) + FIVE_TUPLE_KEY_BYTES)
+
+// 32-bit fingerprint of a 13-byte five tuple, never 0 so that it cannot
+// match the key lane of an empty slot. Bytes 0..7 and 5..12 are read as two
+// overlapping 8-byte loads: a 5-byte copy into a zeroed word goes through
+// the stack and stalls on store forwarding.
+static inline uint32_t five_tuple_fp(const uint8_t *key)
+{
+	uint64_t a, b;
+	memcpy(&a, key, 8);
+	memcpy(&b, key + KEY_LENGTH_13 - 8, 8);
+	uint64_t h = a * 0x9E3779B97F4A7C15ull ^ (b + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+	h ^= h >> 32;
+	h *= 0x94D049BB133111EBull;
+	uint32_t fp = (uint32_t)(h >> 32);
+	return fp ? fp : 1;
+}
+
+// Elastic_2FA_HeavyPart keyed on the whole 13-byte five tuple. The bucket
+// is the same one-cache-line fingerprint/counter layout searched by
+// bucket_quick_insert, with the fingerprint in the key lane; the five tuple
+// of each slot lives in a separate array that the insert path only writes
+// when a slot is taken over (empty or swap), and that query and
+// get_heavy_hitters read to report exact keys.
+template <int bucket_num>
+class FiveTuple_2FA_HeavyPart
+{
+public:
+	alignas(64) Bucket buckets[bucket_num];
+	uint8_t flow_keys[bucket_num][MAX_VALID_COUNTER][KEY_LENGTH_13];
+	BOBHash32 *bobhash = NULL;
+	int cnt, cnt_all;
+
+	FiveTuple_2FA_HeavyPart()
+	{
+		clear();
+		std::random_device rd;
+		bobhash = new BOBHash32(rd() % MAX_PRIME32);
+	}
+	~FiveTuple_2FA_HeavyPart()
+	{
+		delete bobhash;
+	}
+
+	void clear()
+	{
+		cnt = 0, cnt_all = 0;
+		memset(buckets, 0, sizeof(Bucket) * bucket_num);
+		memset(flow_keys, 0, sizeof(flow_keys));
+	}
+
+	// thres_set != 0, first insert, == 0, second insert
+	int quick_insert(const uint8_t *key, uint32_t f = 1, uint32_t thres_set = 0)
+	{
+		uint32_t fp = five_tuple_fp(key);
+		return quick_insert_at(CalculatePos(key, fp, thres_set == 0), key, fp, f, thres_set);
+	}
+
+	/* batched insertion, see Elastic_2FA_HeavyPart::insert_batch */
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set)
+	{
+		uint32_t fps[BATCH_PREFETCH_DIST];
+		int poses[BATCH_PREFETCH_DIST];
+
+		size_t warm = n < BATCH_PREFETCH_DIST ? n : BATCH_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
+		{
+			fps[i] = five_tuple_fp(keys + i * stride);
+			poses[i] = CalculatePos(keys + i * stride, fps[i]);
+			prefetch_bucket(&buckets[poses[i]]);
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t slot = i & (BATCH_PREFETCH_DIST - 1);
+			uint32_t fp = fps[slot];
+			int pos = poses[slot];
+
+			size_t ahead = i + BATCH_PREFETCH_DIST;
+			if (ahead < n)
+			{
+				fps[slot] = five_tuple_fp(keys + ahead * stride);
+				poses[slot] = CalculatePos(keys + ahead * stride, fps[slot]);
+				prefetch_bucket(&buckets[poses[slot]]);
+			}
+
+			int res = quick_insert_at(pos, keys + i * stride, fp, f, thres_set);
+			if (res == thres_set)
+				quick_insert(keys + i * stride, f);
+		}
+	}
+
+	/* query: counts of the slots whose fingerprint and stored key both match */
+	uint32_t query(const uint8_t *key, int thres_set)
+	{
+		uint32_t fp = five_tuple_fp(key);
+		int pos = CalculatePos(key, fp);
+
+		uint32_t res = 0, min_cnt = UINT32_MAX;
+		for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		{
+			if (buckets[pos].key[i] == fp && memcmp(flow_keys[pos][i], key, KEY_LENGTH_13) == 0)
+				res += buckets[pos].val[i];
+			min_cnt = min(min_cnt, buckets[pos].val[i]);
+		}
+		if (min_cnt >= thres_set)
+		{
+			pos = CalculatePos(key, fp, true);
+			for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+				if (buckets[pos].key[i] == fp && memcmp(flow_keys[pos][i], key, KEY_LENGTH_13) == 0)
+					res += buckets[pos].val[i];
+		}
+
+		return res;
+	}
+
+	/* heavy hitters, see Elastic_2FA_HeavyPart::for_each_heavy_hitter;
+	   visit(key, count) gets the 13-byte five tuple */
+	template <typename Visitor>
+	void for_each_heavy_hitter(int threshold, Visitor &&visit)
+	{
+		uint32_t half = threshold > 1 ? (threshold + 1) / 2 : 1;
+		for (int i = 0; i < bucket_num; ++i)
+		{
+			uint32_t mask = bucket_slots_at_least(buckets[i], half);
+			while (mask)
+			{
+				int j = __builtin_ctz(mask);
+				mask &= mask - 1;
+				const uint8_t *key = flow_keys[i][j];
+				uint32_t fp = buckets[i].key[j];
+				uint32_t val = buckets[i].val[j];
+
+				int primary = CalculatePos(key, fp), backup = CalculatePos(key, fp, true);
+				int other = i == primary ? backup : (i == backup ? primary : i);
+				if (other != i)
+				{
+					uint32_t other_val = 0;
+					for (int k = 0; k < MAX_VALID_COUNTER; ++k)
+						if (buckets[other].key[k] == fp && memcmp(flow_keys[other][k], key, KEY_LENGTH_13) == 0)
+							other_val = buckets[other].val[k];
+					if (other_val >= half && other < i)
+						continue;
+					val += other_val;
+				}
+				if ((int)val >= threshold)
+					visit(key, (int)val);
+			}
+		}
+	}
+
+	/* interface */
+	int get_memory_usage()
+	{
+		return bucket_num * FIVE_TUPLE_BUCKET_BYTES;
+	}
+	int get_bucket_num()
+	{
+		return bucket_num;
+	}
+
+private:
+	int quick_insert_at(int pos, const uint8_t *key, uint32_t fp, uint32_t f, uint32_t thres_set)
+	{
+		int stored = -1;
+		int res = bucket_quick_insert(buckets[pos], fp, f, thres_set, cnt, cnt_all, &stored);
+		if (stored >= 0)
+			memcpy(flow_keys[pos][stored], key, KEY_LENGTH_13);
+		return res;
+	}
+
+	int CalculatePos(const uint8_t *key, uint32_t fp, bool isBackup = false)
+	{
+		if (!isBackup)
+			return CalculateBucketPos(fp) % bucket_num;
+#ifdef BACKUP_SINGLE_HASH
+		return CalculateBucketPos2(fp) % bucket_num;
+#else
+		return bobhash->run((const char *)key, KEY_LENGTH_13) % bucket_num;
+#endif
+	}
+};
+
+#endif
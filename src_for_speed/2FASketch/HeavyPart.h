@@ -2,6 +2,131 @@
 #define ELASTIC_2FA_HEAVYPART_SPEED_H_
 
 #include "param.h"
+static inline uint32_t count_trailing_zeros(uint32_t x) {
+    if (x == 0) return 32;
+    return __builtin_ctz(x);
+}
+
+// SIMD match/min of one bucket, shared by every heavy part layout. Returns
+// thres_set if the primary bucket is saturated, see quick_insert. If stored
+// is given, it is set to the slot fp is newly written to (empty or swap);
+// swap_key/swap_val, to the key and counter a swap evicts.
+static inline int bucket_quick_insert(Bucket &bucket, uint32_t fp, uint32_t f, uint32_t thres_set, int &cnt, int &cnt_all, int *stored = NULL,
+									  uint32_t *swap_key = NULL, uint32_t *swap_val = NULL)
+{
+#ifdef BUCKET_AVX512
+	const __m512i item = _mm512_set1_epi32((int)fp);
+	__mmask16 matched = _mm512_cmpeq_epi32_mask(item, _mm512_load_si512(bucket.key));
+
+	if (matched != 0)
+	{
+		int matched_index = count_trailing_zeros((uint32_t)matched);
+		RECORD_INSERT_OUTCOME(INSERT_HIT);
+		bucket.val[matched_index] += f;
+		return 0;
+	}
+
+	// the guard lane is left out of the min instead of being forced to max
+	const __mmask16 valid = (__mmask16)((1u << MAX_VALID_COUNTER) - 1);
+	__m512i results = _mm512_and_si512(_mm512_load_si512(bucket.val), _mm512_set1_epi32(0x7FFFFFFF));
+	int min_counter_val = _mm512_mask_reduce_min_epi32(valid, results);
+
+	matched = _mm512_mask_cmpeq_epi32_mask(valid, _mm512_set1_epi32(min_counter_val), results);
+	int min_counter = count_trailing_zeros((uint32_t)matched);
+#else
+	int min_counter;
+	uint32_t min_val;
+	int matched_index = bucket_match_min(bucket.key, fp, min_counter, min_val);
+
+	if (matched_index >= 0)
+	{
+		RECORD_INSERT_OUTCOME(INSERT_HIT);
+		bucket.val[matched_index] += f;
+		return 0;
+	}
+	int min_counter_val = (int)min_val;
+#endif
+
+	if (min_counter_val == 0)
+	{
+		RECORD_INSERT_OUTCOME(INSERT_EMPTY);
+		bucket.key[min_counter] = fp;
+		bucket.val[min_counter] = f;
+		if (stored)
+			*stored = min_counter;
+		return 0;
+	}
+
+	//
+	if (thres_set != 0 && min_counter_val > thres_set){
+		RECORD_INSERT_OUTCOME(INSERT_BACKUP);
+		cnt++;
+		return thres_set;
+	}
+	cnt_all++;
+
+	uint32_t guard_val = bucket.val[MAX_VALID_COUNTER];
+	guard_val = UPDATE_GUARD_VAL(guard_val);
+
+	if (!JUDGE_IF_SWAP(min_counter_val, guard_val))
+	{
+		RECORD_INSERT_OUTCOME(INSERT_GUARD);
+		bucket.val[MAX_VALID_COUNTER] = guard_val;
+		return 2;
+	}
+
+	bucket.val[MAX_VALID_COUNTER] = 0;
+
+	if (swap_key)
+	{
+		*swap_key = bucket.key[min_counter];
+		*swap_val = min_counter_val;
+	}
+	bucket.key[min_counter] = fp;
+	bucket.val[min_counter] = guard_val;
+	RECORD_INSERT_OUTCOME(INSERT_SWAP);
+	if (stored)
+		*stored = min_counter;
+	return 1;
+}
+
+// a bucket spans sizeof(Bucket) / 64 cache lines
+static inline void prefetch_bucket(const Bucket *bucket)
+{
+	for (size_t off = 0; off < sizeof(Bucket); off += 64)
+		_mm_prefetch((const char *)bucket + off, _MM_HINT_T0);
+}
+
+// mask of the valid slots whose counter, without the swapped-in flag, is
+// >= min_val
+static inline uint32_t bucket_slots_at_least(const Bucket &bucket, uint32_t min_val)
+{
+	const uint32_t valid = (1u << MAX_VALID_COUNTER) - 1;
+#ifdef BUCKET_AVX512
+	__m512i v = _mm512_and_si512(_mm512_loadu_si512(bucket.val), _mm512_set1_epi32(0x7FFFFFFF));
+	return _mm512_cmpge_epu32_mask(v, _mm512_set1_epi32((int)min_val)) & valid;
+#elif defined(__AVX2__)
+	// no unsigned compare before AVX-512: v >= min_val iff max(v, min_val) == v
+	__m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)bucket.val), _mm256_set1_epi32(0x7FFFFFFF));
+	__m256i ge = _mm256_cmpeq_epi32(_mm256_max_epu32(v, _mm256_set1_epi32((int)min_val)), v);
+	return _mm256_movemask_ps(_mm256_castsi256_ps(ge)) & valid;
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		if (GetCounterVal(bucket.val[i]) >= min_val)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// counter of fp in bucket, 0 if it is not there
+static inline uint32_t bucket_counter_of(const Bucket &bucket, uint32_t fp)
+{
+	for (int i = 0; i < MAX_VALID_COUNTER; ++i)
+		if (bucket.key[i] == fp)
+			return GetCounterVal(bucket.val[i]);
+	return 0;
+}
 
 template <int bucket_num>
 class Elastic_2FA_HeavyPart
@@ -9,74 +134,71 @@ class Elastic_2FA_HeavyPart
 public:
 	alignas(64) Bucket buckets[bucket_num];
 	BOBHash32 *bobhash = NULL;
+	uint32_t seed;	// prime index of bobhash, the backup bucket hash
 	int cnt, cnt_all;
 
-	Elastic_2FA_HeavyPart()
+	Elastic_2FA_HeavyPart(uint32_t seed = SKETCH_RANDOM_SEED)
 	{
 		clear();
-		std::random_device rd;
-		bobhash = new BOBHash32(rd() % MAX_PRIME32);
+		this->seed = sketch_seed(seed);
+		bobhash = new BOBHash32(this->seed);
 	}
 	~Elastic_2FA_HeavyPart() {}
 
+	void set_seed(uint32_t seed)
+	{
+		this->seed = sketch_seed(seed);
+		bobhash->initialize(this->seed);
+	}
+
+	// adds the counters of other, which has the same seed, bucket by bucket;
+	// counters that no longer fit are dropped like swapped-out ones
+	void merge(const Elastic_2FA_HeavyPart &other)
+	{
+		merge(other, [](uint32_t, uint32_t) {});
+	}
+
+	// as above, calling spill(key, count) for every dropped counter
+	template <typename Spill>
+	void merge(const Elastic_2FA_HeavyPart &other, Spill &&spill)
+	{
+		for (int i = 0; i < bucket_num; ++i)
+		{
+			bucket_merge(buckets[i].key, buckets[i].val, other.buckets[i].key, other.buckets[i].val,
+						 MAX_VALID_COUNTER, 0x7FFFFFFF, spill);
+			buckets[i].val[MAX_VALID_COUNTER] += other.buckets[i].val[MAX_VALID_COUNTER];
+		}
+		cnt += other.cnt, cnt_all += other.cnt_all;
+	}
+
 	void clear()
 	{
 		cnt = 0, cnt_all = 0;
 		memset(buckets, 0, sizeof(Bucket) * bucket_num);
 	}
 
+#ifndef BUCKET_AVX512
 	/* insertion */
 	int insert(uint8_t *key, uint8_t *swap_key, uint32_t &swap_val, uint32_t f = 1)
 	{
 		uint32_t fp;
 		int pos = CalculateFP(key, fp);
 
-		const __m256i item = _mm256_set1_epi32((int)fp);
-		__m256i *keys_p = (__m256i *)(buckets[pos].key);
-		int matched = 0;
-
-		__m256i a_comp = _mm256_cmpeq_epi32(item, keys_p[0]);
-		matched = _mm256_movemask_ps((__m256)a_comp);
+		int min_counter;
+		uint32_t min_val;
+		int matched_index = bucket_match_min(buckets[pos].key, fp, min_counter, min_val);
 
-		if (matched != 0)
+		if (matched_index >= 0)
 		{
-			// return 32 if input is zero;
-			int matched_index = _tzcnt_u32((uint32_t)matched);
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
 			buckets[pos].val[matched_index] += f;
 			return 0;
 		}
-
-		const uint32_t mask_base = 0x7FFFFFFF;
-		const __m256i *counters = (__m256i *)(buckets[pos].val);
-		__m256 masks = (__m256)_mm256_set1_epi32(mask_base);
-
-		__m256 results = (_mm256_and_ps(*(__m256 *)counters, masks));
-
-		__m256 mask2 = (__m256)_mm256_set_epi32(mask_base, 0, 0, 0, 0, 0, 0, 0);
-
-		results = _mm256_or_ps(results, mask2);
-
-		__m128i low_part = _mm_castps_si128(_mm256_extractf128_ps(results, 0));
-
-		__m128i high_part = _mm_castps_si128(_mm256_extractf128_ps(results, 1));
-
-		__m128i x = _mm_min_epi32(low_part, high_part);
-		__m128i min1 = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
-		// #define _MM_SHUFFLE(fp3, fp2, fp1, fp0) (((fp3) << 6) | ((fp2) << 4) | ((fp1) << 2) | ((fp0)))
-		__m128i min2 = _mm_min_epi32(x, min1);
-		__m128i min3 = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
-		__m128i min4 = _mm_min_epi32(min2, min3);
-		int min_counter_val = _mm_cvtsi128_si32(min4);
-
-		const __m256i ct_item = _mm256_set1_epi32(min_counter_val);
-		int ct_matched = 0;
-
-		__m256i ct_a_comp = _mm256_cmpeq_epi32(ct_item, (__m256i)results);
-		matched = _mm256_movemask_ps((__m256)ct_a_comp);
-		int min_counter = _tzcnt_u32((uint32_t)matched);
+		int min_counter_val = (int)min_val;
 
 		if (min_counter_val == 0) // empty counter
 		{
+			RECORD_INSERT_OUTCOME(INSERT_EMPTY);
 			buckets[pos].key[min_counter] = fp;
 			buckets[pos].val[min_counter] = f;
 			return 0;
@@ -87,6 +209,7 @@ public:
 
 		if (!JUDGE_IF_SWAP(min_counter_val, guard_val))
 		{
+			RECORD_INSERT_OUTCOME(INSERT_GUARD);
 			buckets[pos].val[MAX_VALID_COUNTER] = guard_val;
 			return 2;
 		}
@@ -99,81 +222,77 @@ public:
 		buckets[pos].key[min_counter] = fp;
 		buckets[pos].val[min_counter] = guard_val;
 
+		RECORD_INSERT_OUTCOME(INSERT_SWAP);
 		return 1;
 	}
+#endif
 
 	// thres_set != 0, first insert, == 0, second insert
 	int quick_insert(uint8_t *key, uint32_t f = 1, uint32_t thres_set = 0)
 	{
 		uint32_t fp;
 		int pos = CalculateFP(key, fp, thres_set == 0);
+		return quick_insert_at(pos, fp, f, thres_set);
+	}
 
-		const __m256i item = _mm256_set1_epi32((int)fp);
-		__m256i *keys_p = (__m256i *)(buckets[pos].key);
-		int matched = 0;
-
-		__m256i a_comp = _mm256_cmpeq_epi32(item, keys_p[0]);
-		matched = _mm256_movemask_ps((__m256)a_comp);
-
-		if (matched != 0)
-		{
-			int matched_index = _tzcnt_u32((uint32_t)matched);
-			buckets[pos].val[matched_index] += f;
-			return 0;
-		}
-
-		const uint32_t mask_base = 0x7FFFFFFF;
-		const __m256i *counters = (__m256i *)(buckets[pos].val);
-		__m256 masks = (__m256)_mm256_set1_epi32(mask_base);
-		__m256 results = (_mm256_and_ps(*(__m256 *)counters, masks));
-		__m256 mask2 = (__m256)_mm256_set_epi32(mask_base, 0, 0, 0, 0, 0, 0, 0);
-		results = _mm256_or_ps(results, mask2);
-
-		__m128i low_part = _mm_castps_si128(_mm256_extractf128_ps(results, 0));
-		__m128i high_part = _mm_castps_si128(_mm256_extractf128_ps(results, 1));
-
-		__m128i x = _mm_min_epi32(low_part, high_part);
-		__m128i min1 = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
-		__m128i min2 = _mm_min_epi32(x, min1);
-		__m128i min3 = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
-		__m128i min4 = _mm_min_epi32(min2, min3);
-		int min_counter_val = _mm_cvtsi128_si32(min4);
+	// as above, with the key and counter evicted by a swap (1). The counter
+	// of a swapped-in key gets the highest bit, as in Elastic: its guard count
+	// stands for packets that went to the light part.
+	int quick_insert(uint8_t *key, uint32_t f, uint32_t thres_set, uint32_t &swap_key, uint32_t &swap_val)
+	{
+		uint32_t fp;
+		int pos = CalculateFP(key, fp, thres_set == 0);
+		return swap_insert_at(pos, fp, f, thres_set, swap_key, swap_val);
+	}
 
-		const __m256i ct_item = _mm256_set1_epi32(min_counter_val);
-		int ct_matched = 0;
+	/* batched insertion: keys are n records of stride bytes each, the first
+	   4 bytes of every record are the flow key. Bucket positions are computed
+	   BATCH_PREFETCH_DIST records ahead and prefetched, so the bucket is
+	   already resident when the SIMD match/min runs on it. thres_set is the
+	   sketch's, as for the first quick_insert: packets it turns away go to
+	   the backup bucket. */
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set)
+	{
+		insert_batch(keys, n, stride, f, thres_set, [](uint32_t, uint32_t, bool) {});
+	}
 
-		__m256i ct_a_comp = _mm256_cmpeq_epi32(ct_item, (__m256i)results);
-		matched = _mm256_movemask_ps((__m256)ct_a_comp);
-		int min_counter = _tzcnt_u32((uint32_t)matched);
+	// calls spill(key, count, swapped) for what the heavy part lets go of: a
+	// packet the guard turned away (count f) or the counter a swap evicted
+	template <typename Spill>
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, uint32_t f, uint32_t thres_set, Spill &&spill)
+	{
+		uint32_t fps[BATCH_PREFETCH_DIST];
+		int poses[BATCH_PREFETCH_DIST];
 
-		if (min_counter_val == 0)
+		size_t warm = n < BATCH_PREFETCH_DIST ? n : BATCH_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
 		{
-			buckets[pos].key[min_counter] = fp;
-			buckets[pos].val[min_counter] = f;
-			return 0;
+			poses[i] = CalculateFP((uint8_t *)(keys + i * stride), fps[i]);
+			prefetch_bucket(&buckets[poses[i]]);
 		}
 
-		//
-		if (thres_set != 0 && min_counter_val > thres_set){
-			cnt++;
-			return thres_set;
-		}
-		cnt_all++;
-
-		uint32_t guard_val = buckets[pos].val[MAX_VALID_COUNTER];
-		guard_val = UPDATE_GUARD_VAL(guard_val);
-
-		if (!JUDGE_IF_SWAP(min_counter_val, guard_val))
+		for (size_t i = 0; i < n; ++i)
 		{
-			buckets[pos].val[MAX_VALID_COUNTER] = guard_val;
-			return 2;
-		}
+			size_t slot = i & (BATCH_PREFETCH_DIST - 1);
+			uint32_t fp = fps[slot];
+			int pos = poses[slot];
 
-		buckets[pos].val[MAX_VALID_COUNTER] = 0;
+			size_t ahead = i + BATCH_PREFETCH_DIST;
+			if (ahead < n)
+			{
+				poses[slot] = CalculateFP((uint8_t *)(keys + ahead * stride), fps[slot]);
+				prefetch_bucket(&buckets[poses[slot]]);
+			}
 
-		buckets[pos].key[min_counter] = fp;
-		buckets[pos].val[min_counter] = guard_val;
-		return 1;
+			uint32_t swap_key, swap_val;
+			int res = swap_insert_at(pos, fp, f, thres_set, swap_key, swap_val);
+			if (res == thres_set)
+				res = quick_insert((uint8_t *)(keys + i * stride), f, 0, swap_key, swap_val);
+			if (res == 1)
+				spill(swap_key, swap_val, true);
+			else if (res == 2)
+				spill(fp, f, false);
+		}
 	}
 
 	/* query */
@@ -187,9 +306,9 @@ public:
 		{
 			if (buckets[pos].key[i] == fp)
 			{
-				res += buckets[pos].val[i];
+				res += GetCounterVal(buckets[pos].val[i]);
 			}
-			min_cnt = min(min_cnt, buckets[pos].val[i]);
+			min_cnt = min(min_cnt, GetCounterVal(buckets[pos].val[i]));
 		}
 		if (min_cnt >= thres_set)
 		{
@@ -198,7 +317,7 @@ public:
 			{
 				if (buckets[pos].key[i] == fp)
 				{
-					res += buckets[pos].val[i];
+					res += GetCounterVal(buckets[pos].val[i]);
 				}
 			}
 		}
@@ -206,6 +325,41 @@ public:
 		return res;
 	}
 
+	/* heavy hitters: visit(key, count) once per key counted at least
+	   threshold (>= 1) times. A key is only ever stored in its primary and
+	   backup buckets, so one of its at most two counters is at least half the
+	   threshold: buckets are scanned for such counters with SIMD and each one
+	   is completed with the key's counter in its other bucket. No map and no
+	   allocation. */
+	template <typename Visitor>
+	void for_each_heavy_hitter(int threshold, Visitor &&visit)
+	{
+		uint32_t half = threshold > 1 ? (threshold + 1) / 2 : 1;
+		for (int i = 0; i < bucket_num; ++i)
+		{
+			uint32_t mask = bucket_slots_at_least(buckets[i], half);
+			while (mask)
+			{
+				int j = __builtin_ctz(mask);
+				mask &= mask - 1;
+				uint32_t fp = buckets[i].key[j];
+				uint32_t val = GetCounterVal(buckets[i].val[j]);
+
+				int other = other_bucket(i, fp);
+				if (other >= 0)
+				{
+					uint32_t other_val = bucket_counter_of(buckets[other], fp);
+					// a candidate in both buckets is reported from the lower one
+					if (other_val >= half && other < i)
+						continue;
+					val += other_val;
+				}
+				if ((int)val >= threshold)
+					visit(fp, (int)val);
+			}
+		}
+	}
+
 	/* interface */
 	int get_memory_usage()
 	{
@@ -217,13 +371,41 @@ public:
 	}
 
 private:
+	int quick_insert_at(int pos, uint32_t fp, uint32_t f, uint32_t thres_set)
+	{
+		return bucket_quick_insert(buckets[pos], fp, f, thres_set, cnt, cnt_all);
+	}
+
+	int swap_insert_at(int pos, uint32_t fp, uint32_t f, uint32_t thres_set, uint32_t &swap_key, uint32_t &swap_val)
+	{
+		int stored;
+		int res = bucket_quick_insert(buckets[pos], fp, f, thres_set, cnt, cnt_all, &stored, &swap_key, &swap_val);
+		if (res == 1)
+			buckets[pos].val[stored] |= 0x80000000;
+		return res;
+	}
+
+	// the bucket other than pos that key fp can be stored in, -1 if none
+	int other_bucket(int pos, uint32_t fp)
+	{
+		uint32_t key = fp;
+		int primary = CalculateFP((uint8_t *)&key, fp);
+		int backup = CalculateFP((uint8_t *)&key, fp, true);
+		if (primary == backup)
+			return -1;
+		return pos == primary ? backup : (pos == backup ? primary : -1);
+	}
+
 	int CalculateFP(uint8_t *key, uint32_t &fp, bool isBackup = false)
 	{
 		fp = *((uint32_t *)key);
 		if (!isBackup)
 			return CalculateBucketPos(fp) % bucket_num;
-		else
-			return bobhash->run((const char *)key, 4) % bucket_num;
+#ifdef BACKUP_SINGLE_HASH
+		return CalculateBucketPos2(fp) % bucket_num;
+#else
+		return bobhash->run((const char *)key, 4) % bucket_num;
+#endif
 	}
 };
 
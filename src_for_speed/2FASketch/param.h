@@ -2,6 +2,10 @@
 #define ELASTIC_2FA_PARAM_H_
 #define WIN32
 #include "../common/BOBHash32.h"
+#include "../common/bucket_kernel.h"
+#include "../common/latency_hist.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/sketch_alloc.h"
 
 #include <x86intrin.h>
 #include <string.h>
@@ -13,8 +17,20 @@
 #include <cmath>
 #include <math.h>
 
+// -DBUCKET_AVX512 selects 16 slots per bucket: one 64-byte line of keys and
+// one of counters, searched with AVX-512. Default is 8 + 8 in one line (AVX2).
+// The 128-byte bucket spans two lines, so at the same memory it is no faster
+// than the default, see README.md.
+#ifdef BUCKET_AVX512
+#ifndef __AVX512F__
+#error "BUCKET_AVX512 needs a compiler target with AVX-512F"
+#endif
+#define COUNTER_PER_BUCKET 16
+#define MAX_VALID_COUNTER 15
+#else
 #define COUNTER_PER_BUCKET 8
 #define MAX_VALID_COUNTER 7
+#endif
 
 #define ALIGNMENT 64
 
@@ -22,15 +38,24 @@
 #define BIT_TO_DETERMINE_COUNTER 3
 #define K_HASH_WORD 1
 
+// records hashed ahead of the one being inserted by insert_batch, power of 2
+#define BATCH_PREFETCH_DIST 16
+
 
 #define KEY_LENGTH_4 4
 #define KEY_LENGTH_13 13
 
+// The backup bucket of a key whose primary bucket is above thres_set comes
+// from BOBHash32 by default. -DBACKUP_SINGLE_HASH derives it from the
+// fingerprint with a second multiplier instead (CalculateBucketPos2).
 #define CONSTANT_NUMBER 2654435761u
 #define ANOTHER_BIG_PRIME_NUMBER 3344921057u
 #define CalculateBucketPos(fp) (((fp) * CONSTANT_NUMBER) >> 15)
 #define CalculateBucketPos2(fp) (((fp) * ANOTHER_BIG_PRIME_NUMBER) >> 12)
 
+#define SHARD_HASH_NUMBER 2246822507u
+#define CalculateShardPos(fp) (((fp) * SHARD_HASH_NUMBER) >> 16)
+
 #define GetCounterVal(val) ((uint32_t)((val) & 0x7FFFFFFF))
 
 #define JUDGE_IF_SWAP(min_val, guard_val) ((guard_val) >  (min_val ) )
@@ -45,7 +70,7 @@
 
 
 
-struct Bucket
+struct alignas(ALIGNMENT) Bucket
 {
 	uint32_t key[COUNTER_PER_BUCKET];
 	uint32_t val[COUNTER_PER_BUCKET];
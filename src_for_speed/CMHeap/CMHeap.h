@@ -6,12 +6,17 @@
 #include <sstream>
 #include "../common/BOBHash32.h"
 #include "../common/cuckoo_hashing.h"
+#include "../common/sketch_alloc.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/row_hash.h"
 
 using std::min;
 using std::swap;
 
-template<uint8_t key_len, int capacity, int d = 3>
+// RowHash picks how the d columns of a key are hashed, see common/row_hash.h
+template<uint8_t key_len, int capacity, int d = 3, typename RowHash = BobRowHash>
 struct CMHeap {
+    static_assert(d <= ROW_HASH_MAX_ROWS, "too many rows");
     typedef pair <uint8_t[key_len], int> KV;
 //    typedef pair <int, string> VK;
     KV heap[capacity];
@@ -19,7 +24,7 @@ struct CMHeap {
     int mem_in_bytes;
     int w;
     int * cm_sketch[d];
-    BOBHash32 * hash[d];
+    RowHash row_hash;
 //    BOBHash32 * hash_polar[d];
 //    unordered_map<string, uint32_t> ht;
     cuckoo::CuckooHashing<key_len, int(capacity * 2)> ht;
@@ -62,11 +67,11 @@ struct CMHeap {
 
 public:
     string name;
-    CMHeap(int mem_in_bytes_) : mem_in_bytes(mem_in_bytes_), heap_element_num(0) {
+    CMHeap(int mem_in_bytes_, uint32_t seed = SKETCH_RANDOM_SEED) : mem_in_bytes(mem_in_bytes_), heap_element_num(0) {
         w = mem_in_bytes / 4 / d;
         for(int i = 0; i < d; i ++)
         {
-        	cm_sketch[i] = new int[w];
+        	cm_sketch[i] = (int *)sketch_alloc(sizeof(int) * w);
         	memset(cm_sketch[i], 0, sizeof(int)*w);
         }
 		memset(heap, 0, sizeof(heap));
@@ -74,10 +79,7 @@ public:
             heap[i].second = 0;
         }
         
-        random_device rd;
-        for (int i = 0; i < d; i++) {
-            hash[i] = new BOBHash32(uint32_t(rd() % MAX_PRIME32));
-        }
+        row_hash.init(d, sketch_seed(seed));
 
         stringstream name_buf;
         name_buf << "CMHeap@" << mem_in_bytes;
@@ -86,11 +88,12 @@ public:
 
     void insert(uint8_t * key) {
         int tmin = 1 << 30, ans = tmin;
+        uint32_t idx[d];
+        row_hash.columns(key, key_len, w, idx);
 
         for (int i = 0; i < d; ++i) {
-            int idx = hash[i]->run((char *)key, key_len) % w;
-            cm_sketch[i][idx]++;
-            int val = cm_sketch[i][idx];
+            cm_sketch[i][idx[i]]++;
+            int val = cm_sketch[i][idx[i]];
 
             ans = std::min(val, ans);
         }
@@ -126,9 +129,10 @@ public:
 
     int query(uint8_t * key) {
         int tmin = 1 << 30, ans = tmin;
+        uint32_t idx[d];
+        row_hash.columns(key, key_len, w, idx);
         for(int i = 0; i < d; ++i){
-            int idx = hash[i]->run((char*)key, key_len) % w;
-            int val = cm_sketch[i][idx];
+            int val = cm_sketch[i][idx[i]];
             ans = std::min(val, ans);
         }
         return ans;
@@ -146,8 +150,7 @@ public:
 
     ~CMHeap() {
         for (int i = 0; i < d; ++i) {
-            delete hash[i];
-            delete cm_sketch[i];
+            sketch_free(cm_sketch[i]);
         }
         return;
     }
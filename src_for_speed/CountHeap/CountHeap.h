@@ -9,25 +9,30 @@
 #include <cstring>
 #include <time.h>
 #include "../common/BOBHash32.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/row_hash.h"
+#include "../common/flat_index.h"
 
 using std::min;
 using std::swap;
 
 #define SQR(X) (X) * (X)
 
-template<uint8_t key_len, int capacity, int d = 3>
+// RowHash picks how the d columns and signs of a key are hashed, see
+// common/row_hash.h
+template<uint8_t key_len, int capacity, int d = 3, typename RowHash = BobRowHash>
 struct CountHeap {
+    static_assert(d <= ROW_HASH_MAX_ROWS, "too many rows");
 public:
     typedef pair <string, int> KV;
-    typedef pair <int, string> VK;
+    typedef pair <int, uint8_t[key_len]> VK;
     VK heap[capacity];
     int heap_element_num;
     int mem_in_bytes;
     int w;
     int * cm_sketch[d];
-    BOBHash32 * hash[d];
-    BOBHash32 * hash_polar[d];
-    unordered_map<string, uint32_t> ht;
+    RowHash row_hash;
+    FlatIndex<key_len, capacity> ht;    // heap position of every key in the heap
 
     double get_f2()
     {
@@ -54,15 +59,16 @@ public:
             int l_child = 2 * i + 1;
             int r_child = 2 * i + 2;
             int larger_one = i;
-            if (l_child < heap_element_num && heap[l_child] < heap[larger_one]) {
+            if (l_child < heap_element_num && heap[l_child].first < heap[larger_one].first) {
                 larger_one = l_child;
             }
-            if (r_child < heap_element_num && heap[r_child] < heap[larger_one]) {
+            if (r_child < heap_element_num && heap[r_child].first < heap[larger_one].first) {
                 larger_one = r_child;
             }
             if (larger_one != i) {
                 swap(heap[i], heap[larger_one]);
-                swap(ht[heap[i].second], ht[heap[larger_one].second]);
+                *ht.find(heap[i].second) = i;
+                *ht.find(heap[larger_one].second) = larger_one;
                 heap_adjust_down(larger_one);
             } else {
                 break;
@@ -73,11 +79,12 @@ public:
     void heap_adjust_up(int i) {
         while (i > 1) {
             int parent = (i - 1) / 2;
-            if (heap[parent] <= heap[i]) {
+            if (heap[parent].first <= heap[i].first) {
                 break;
             }
             swap(heap[i], heap[parent]);
-            swap(ht[heap[i].second], ht[heap[parent].second]);
+            *ht.find(heap[i].second) = i;
+            *ht.find(heap[parent].second) = parent;
             i = parent;
         }
     }
@@ -85,17 +92,16 @@ public:
 //public:
     string name;
 
-    CountHeap(int mem_in_bytes_) : mem_in_bytes(mem_in_bytes_), heap_element_num(0) {
+    CountHeap(int mem_in_bytes_, uint32_t seed = SKETCH_RANDOM_SEED) : mem_in_bytes(mem_in_bytes_), heap_element_num(0) {
 //        memset(heap, 0, sizeof(heap));
 		w = mem_in_bytes / 4 / d;
         for (int i = 0; i < capacity; ++i) {
             heap[i].first = 0;
+            memset(heap[i].second, 0, key_len);
         }
         memset(cm_sketch, 0, sizeof(cm_sketch));
-        srand(time(0));
+        row_hash.init(d, sketch_seed(seed));
         for (int i = 0; i < d; i++) {
-            hash[i] = new BOBHash32(uint32_t(rand() % MAX_PRIME32));
-            hash_polar[i] = new BOBHash32(uint32_t(rand() % MAX_PRIME32));
             cm_sketch[i] = new int[w];
             memset(cm_sketch[i], 0, sizeof(int)*w);
         }
@@ -107,16 +113,16 @@ public:
 
     void insert(uint8_t * key) {
         int ans[d];
+        uint32_t idx[d];
+        int sign[d];
+        row_hash.columns_signs(key, key_len, w, idx, sign);
 
         for (int i = 0; i < d; ++i) {
-            int idx = hash[i]->run((char *)key, key_len) % w;
-            int polar = hash_polar[i]->run((char *)key, key_len) % 2;
+            cm_sketch[i][idx[i]] += sign[i];
 
-            cm_sketch[i][idx] += polar ? 1 : -1;
+            int val = cm_sketch[i][idx[i]];
 
-            int val = cm_sketch[i][idx];
-
-            ans[i] = polar ? val : -val;
+            ans[i] = sign[i] * val;
         }
 
         sort(ans, ans + d);
@@ -129,21 +135,22 @@ public:
         }
         tmin = (tmin <= 1) ? 1 : tmin;
 
-        string str_key = string((const char *)key, key_len);
-        if (ht.find(str_key) != ht.end()) {
-            heap[ht[str_key]].first++;
-            heap_adjust_down(ht[str_key]);
+        int32_t *pos = ht.find(key);
+        if (pos) {
+            int i = *pos;
+            heap[i].first++;
+            heap_adjust_down(i);
         } else if (heap_element_num < capacity) {
-            heap[heap_element_num].second = str_key;
+            memcpy(heap[heap_element_num].second, key, key_len);
             heap[heap_element_num].first = tmin;
-            ht[str_key] = heap_element_num++;
+            ht.insert(key, heap_element_num++);
             heap_adjust_up(heap_element_num - 1);
         } else if (tmin > heap[0].first) {
             VK & kv = heap[0];
             ht.erase(kv.second);
-            kv.second = str_key;
+            memcpy(kv.second, key, key_len);
             kv.first = tmin;
-            ht[str_key] = 0;
+            ht.insert(key, 0);
             heap_adjust_down(0);
         }
     }
@@ -162,15 +169,15 @@ public:
 //    }
 
     void get_top_k_with_frequency(uint16_t k, vector<KV> & result) {
-        VK * a = new VK[capacity];
+        vector<int> order(capacity);
         for (int i = 0; i < capacity; ++i) {
-            a[i] = heap[i];
+            order[i] = i;
         }
-        sort(a, a + capacity);
+        sort(order.begin(), order.end(), [this](int a, int b) { return heap[a].first > heap[b].first; });
         int i;
         for (i = 0; i < k && i < capacity; ++i) {
-            result[i].first = a[capacity - 1 - i].second;
-            result[i].second = a[capacity - 1 - i].first;
+            result[i].first = string((const char *)heap[order[i]].second, key_len);
+            result[i].second = heap[order[i]].first;
         }
         for (; i < k; ++i) {
 //            result[i].first ;
@@ -195,16 +202,14 @@ public:
         ret.clear();
         for (int i = 0; i < capacity; ++i) {
             if (heap[i].first >= threshold) {
-                ret.emplace_back(make_pair(heap[i].second, heap[i].first));
+                ret.emplace_back(make_pair(string((const char *)heap[i].second, key_len), heap[i].first));
             }
         }
     }
 
     ~CountHeap() {
         for (int i = 0; i < d; ++i) {
-            delete hash[i];
-            delete hash_polar[i];
-            delete cm_sketch[i];
+            delete[] cm_sketch[i];
         }
         return;
     }
@@ -9,17 +9,25 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <x86intrin.h>
 #include "../common/BOBHash32.h"
+#include "../common/sketch_alloc.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/row_hash.h"
 
+#define CHAIN_MAX_DEPTH 8
+// inserts hashed ahead by insert_batch, a power of two
+#define CHAIN_PREFETCH_DIST 8
 
-int MAXINT = 1000000000, chainlength = 2;
-unsigned int bucket = 0, bucket1 = 0;
-int loc = -1, ii = 0;
-static std::random_device rd;
-
-template <int TOT_MEM_IN_BYTES>
+// All the state is in the instance, a random generator included, so
+// instances can be used from different threads; one instance is not
+// thread-safe. For several threads, give each its own instance with the same
+// seed and merge them.
+// RowHash picks how the columns of a key are hashed, see common/row_hash.h.
+template <int TOT_MEM_IN_BYTES, typename RowHash = BobRowHash>
 class ChainSketch
 {
+	static constexpr int MAXINT = 1000000000;
 
 	typedef struct SBUCKET_type
 	{
@@ -29,59 +37,146 @@ class ChainSketch
 
 	struct Chain_type
 	{
-		// Counter table
-		SBucket **counts;
+		// Counter table, depth rows of width buckets in one block
+		SBucket *counts;
 		// Outer sketch depth and width
 		int depth;
 		int width;
-		// # key word bits
-		BOBHash32 *hardner;
+		RowHash row_hash;
 	};
 
 public:
-	ChainSketch()
+	uint32_t seed;	// prime index the row hashes are seeded with
+
+	// the TOT_MEM_IN_BYTES of buckets are split into depth rows (at most
+	// CHAIN_MAX_DEPTH), fewer and wider rows or more and narrower ones;
+	// instances to be merged must share depth and seed
+	ChainSketch(int depth = 4, uint32_t seed = SKETCH_RANDOM_SEED, int chainlength = 2): chainlength(chainlength)
 	{
-		Chain_.depth = 4;
-		Chain_.width = TOT_MEM_IN_BYTES/4/8;
-		Chain_.counts = new SBucket *[TOT_MEM_IN_BYTES/8];
-		for (int i = 0; i < TOT_MEM_IN_BYTES/8; i++)
-		{
-			Chain_.counts[i] = (SBucket *)calloc(1, sizeof(SBucket));
-			memset(Chain_.counts[i], 0, sizeof(SBucket));
-			// Chain_.counts[i]->key = 0;
-		}
-		Chain_.hardner = new BOBHash32[Chain_.depth];
-		unsigned int seed = rd() % MAX_PRIME32;
+		Chain_.depth = std::min(std::max(depth, 1), CHAIN_MAX_DEPTH);
+		Chain_.width = TOT_MEM_IN_BYTES / Chain_.depth / sizeof(SBucket);
+		Chain_.counts = (SBucket *)sketch_alloc(sizeof(SBucket) * Chain_.depth * Chain_.width);
+		memset(Chain_.counts, 0, sizeof(SBucket) * Chain_.depth * Chain_.width);
+		this->seed = sketch_seed(seed);
+		Chain_.row_hash.init(Chain_.depth, this->seed);
 
-		for (int i = 0; i < Chain_.depth; i++)
+		// splitmix64 of the seed, never 0
+		uint64_t z = this->seed + 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		rng_state = (z ^ (z >> 31)) | 1;
+	}
+
+	~ChainSketch()
+	{
+		sketch_free(Chain_.counts);
+	}
+
+	void insert(uint8_t *key, int val = 1)
+	{
+		uint32_t columns[CHAIN_MAX_DEPTH];
+		hash_columns(key, columns);
+		insert_at(*((uint32_t *)key), columns, val);
+	}
+
+	// keys: n records of stride bytes. The depth columns of a key are hashed
+	// CHAIN_PREFETCH_DIST keys ahead and their buckets prefetched.
+	void insert_batch(const uint8_t *keys, size_t n, size_t stride, int val = 1)
+	{
+		uint32_t columns[CHAIN_PREFETCH_DIST][CHAIN_MAX_DEPTH];
+
+		size_t warm = n < CHAIN_PREFETCH_DIST ? n : CHAIN_PREFETCH_DIST;
+		for (size_t i = 0; i < warm; ++i)
+			prefetch_columns(keys + i * stride, columns[i]);
+
+		for (size_t i = 0; i < n; ++i)
 		{
-			Chain_.hardner[i].initialize((seed++) % MAX_PRIME32);
+			size_t slot = i & (CHAIN_PREFETCH_DIST - 1);
+			uint32_t current[CHAIN_MAX_DEPTH];
+			memcpy(current, columns[slot], sizeof(uint32_t) * Chain_.depth);
+
+			size_t ahead = i + CHAIN_PREFETCH_DIST;
+			if (ahead < n)
+				prefetch_columns(keys + ahead * stride, columns[slot]);
+
+			insert_at(*((const uint32_t *)(keys + i * stride)), current, val);
 		}
 	}
 
-	~ChainSketch()
+	// Adds the buckets of other, which has the same depth and seed: a bucket
+	// is added in place if that bucket here is empty or holds its key, and
+	// inserted with its count otherwise. false if other is not mergeable.
+	bool merge(const ChainSketch &other)
 	{
+		if (other.Chain_.depth != Chain_.depth || other.seed != seed)
+			return false;
 		for (int i = 0; i < Chain_.depth * Chain_.width; i++)
 		{
-			free(Chain_.counts[i]);
+			const SBucket &b = other.Chain_.counts[i];
+			if (b.count == 0)
+				continue;
+			SBucket &a = Chain_.counts[i];
+			if (a.count == 0 || a.key == b.key)
+			{
+				a.key = b.key;
+				a.count += b.count;
+				continue;
+			}
+			uint32_t columns[CHAIN_MAX_DEPTH];
+			hash_columns((const uint8_t *)&b.key, columns);
+			insert_at(b.key, columns, b.count);
 		}
-		delete[] Chain_.hardner;
-		delete[] Chain_.counts;
+		return true;
 	}
 
-	void insert(uint8_t *key, int val = 1)
+	uint32_t get_seed() { return seed; }
+	int get_memory_usage() { return sizeof(SBucket) * Chain_.depth * Chain_.width; }
+
+	void *operator new(size_t sz)
+	{
+		return sketch_alloc(sz);
+	}
+	void operator delete(void *p)
+	{
+		sketch_free(p);
+	}
+
+private:
+	void hash_columns(const uint8_t *key, uint32_t *columns)
+	{
+		Chain_.row_hash.columns(key, 4, Chain_.width, columns);
+	}
+
+	void prefetch_columns(const uint8_t *key, uint32_t *columns)
 	{
-		uint32_t min = 99999999, index, fp;
+		hash_columns(key, columns);
+		for (int i = 0; i < Chain_.depth; i++)
+			_mm_prefetch((const char *)&Chain_.counts[i * Chain_.width + columns[i]], _MM_HINT_T0);
+	}
+
+	// xorshift64*, for the replacement decisions
+	uint32_t next_rand()
+	{
+		rng_state ^= rng_state >> 12;
+		rng_state ^= rng_state << 25;
+		rng_state ^= rng_state >> 27;
+		return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+	}
+
+	void insert_at(uint32_t fp, const uint32_t *columns, int val)
+	{
+		uint32_t min = 99999999, index;
+		uint32_t bucket, bucket1 = columns[0];
+		int loc = columns[0], ii = 0;
 		ChainSketch::SBucket *sbucket;
 		ChainSketch::SBucket *sbucket1;
 		if (!chainlength)
 			return;
-		fp = *((uint32_t *)key);
 		for (int i = 0; i < Chain_.depth; i++)
 		{
-			bucket = Chain_.hardner[i].run((const char *)key, 4) % Chain_.width;
+			bucket = columns[i];
 			index = i * Chain_.width + bucket;
-			sbucket = Chain_.counts[index];
+			sbucket = &Chain_.counts[index];
 			if (sbucket->count == 0)
 			{
 				sbucket->key = fp; // memcpy(sbucket->key, key, key_len);
@@ -101,12 +196,12 @@ public:
 				ii = i;
 			}
 		}
-		sbucket = Chain_.counts[loc];
-		int k = rd() % (sbucket->count + val) + 1;
+		sbucket = &Chain_.counts[loc];
+		int k = next_rand() % (sbucket->count + val) + 1;
 		if (k <= val && chainlength > 0)
 		{
 			index = ii * Chain_.width + (bucket1 + 1) % Chain_.width;
-			sbucket1 = Chain_.counts[index];
+			sbucket1 = &Chain_.counts[index];
 			// if (memcmp(sbucket1->key, sbucket->key, key_len) == 0 && index != loc)
 			if (sbucket1->key == sbucket->key && index != loc)
 			{
@@ -133,7 +228,7 @@ public:
 						ro *= 10;
 					}
 
-					int newk = rd() % ro + 1;
+					int newk = next_rand() % ro + 1;
 					if (newk <= int(ro * po))
 					{
 						sbucket1->key = sbucket->key; // memcpy(sbucket1->key, sbucket->key, key_len);
@@ -141,7 +236,7 @@ public:
 						break;
 					}
 					index = ii * Chain_.width + (index + 1) % Chain_.width;
-					sbucket1 = Chain_.counts[index];
+					sbucket1 = &Chain_.counts[index];
 					round = round + 1;
 					if (sbucket1->key == fp) // if (memcmp(sbucket1->key, key, key_len) == 0)
 					{
@@ -156,6 +251,7 @@ public:
 		}
 	}
 
+public:
 	void get_heavy_hitters(int thresh, vector<std::pair<string, int>> &results)
 	{
 		std::unordered_map<string, int> ground;
@@ -163,8 +259,8 @@ public:
 
 		for (int i = 0; i < Chain_.width * Chain_.depth; i++)
 		{
-			key = string((const char *)(&(Chain_.counts[i]->key)), 4); // memcpy(key, Chain_.counts[i]->key, key_len);
-			ground[key] += Chain_.counts[i]->count;
+			key = string((const char *)(&(Chain_.counts[i].key)), 4); // memcpy(key, Chain_.counts[i].key, key_len);
+			ground[key] += Chain_.counts[i].count;
 		}
 		for (auto it = ground.begin(); it != ground.end();)
 		{
@@ -190,12 +286,7 @@ public:
 	void reset()
 	{
 
-		for (int i = 0; i < Chain_.depth * Chain_.width; i++)
-		{
-			Chain_.counts[i]->count = 0;
-			Chain_.counts[i]->key = 0;
-			// memset(Chain_.counts[i]->key, 0, key_len);
-		}
+		memset(Chain_.counts, 0, sizeof(SBucket) * Chain_.depth * Chain_.width);
 	}
 
 private:
@@ -203,18 +294,20 @@ private:
 	{
 
 		int index = row * Chain_.width + column;
-		Chain_.counts[index]->count = count;
-		Chain_.counts[index]->key = *((uint32_t *)key);
-		// memcpy(Chain_.counts[index]->key, key, key_len);
+		Chain_.counts[index].count = count;
+		Chain_.counts[index].key = *((uint32_t *)key);
+		// memcpy(Chain_.counts[index].key, key, key_len);
 	}
 
-	ChainSketch::SBucket **getTable()
+	ChainSketch::SBucket *getTable()
 	{
 
 		return Chain_.counts;
 	}
 
 	Chain_type Chain_;
+	int chainlength;
+	uint64_t rng_state;
 };
 
 #endif
\ No newline at end of file
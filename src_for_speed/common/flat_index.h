@@ -0,0 +1,118 @@
+#ifndef _FLAT_INDEX_H_
+#define _FLAT_INDEX_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Index from fixed-length keys to small non-negative ints, the positions of
+// the keys in the heap of a top-k sketch. Open addressing with linear
+// probing over a power-of-two table kept at most half full, a slot holding
+// the key next to its value, so a lookup is one hash and usually one cache
+// line. Erasing shifts the following slots of the run back instead of
+// leaving tombstones. Nothing is allocated after construction, and holding
+// more than capacity keys is not allowed.
+template<int key_len, int capacity>
+class FlatIndex
+{
+	struct Slot
+	{
+		uint8_t key[key_len];
+		int32_t val;	// negative: empty
+	};
+
+	static constexpr uint32_t table_size(uint32_t n)
+	{
+		return n <= 1 ? 1 : 2 * table_size((n + 1) / 2);
+	}
+
+	static constexpr uint32_t size = table_size(2 * capacity);
+	static constexpr uint32_t mask = size - 1;
+
+	Slot slots[size];
+
+	static uint32_t hash(const uint8_t *key)
+	{
+		uint32_t h = 0x2545F491, word;
+		int i = 0;
+		for (; i + 4 <= key_len; i += 4)
+		{
+			memcpy(&word, key + i, 4);
+			h = (h ^ word) * 0x9E3779B1u;
+			h ^= h >> 15;
+		}
+		if (i < key_len)
+		{
+			word = 0;
+			memcpy(&word, key + i, key_len - i);
+			h = (h ^ word) * 0x9E3779B1u;
+			h ^= h >> 15;
+		}
+		return h * 0x85EBCA6Bu;
+	}
+
+	uint32_t home(const uint8_t *key)
+	{
+		// the high bits of the last multiply are the best mixed
+		return size == 1 ? 0 : hash(key) >> (32 - __builtin_ctz(size));
+	}
+
+public:
+	FlatIndex()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (uint32_t i = 0; i < size; ++i)
+			slots[i].val = -1;
+	}
+
+	// the value of key, NULL if it is not in the index
+	int32_t *find(const uint8_t *key)
+	{
+		for (uint32_t i = home(key);; i = (i + 1) & mask)
+		{
+			if (slots[i].val < 0)
+				return NULL;
+			if (memcmp(slots[i].key, key, key_len) == 0)
+				return &slots[i].val;
+		}
+	}
+
+	// key must not be in the index yet
+	void insert(const uint8_t *key, int32_t val)
+	{
+		uint32_t i = home(key);
+		while (slots[i].val >= 0)
+			i = (i + 1) & mask;
+		memcpy(slots[i].key, key, key_len);
+		slots[i].val = val;
+	}
+
+	void erase(const uint8_t *key)
+	{
+		uint32_t i = home(key);
+		for (;; i = (i + 1) & mask)
+		{
+			if (slots[i].val < 0)
+				return;
+			if (memcmp(slots[i].key, key, key_len) == 0)
+				break;
+		}
+		// move back every later key of the run whose home is not between
+		// the hole and its slot
+		for (uint32_t j = (i + 1) & mask; slots[j].val >= 0; j = (j + 1) & mask)
+		{
+			uint32_t h = home(slots[j].key);
+			if (((j - h) & mask) >= ((j - i) & mask))
+			{
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].val = -1;
+	}
+};
+
+#endif
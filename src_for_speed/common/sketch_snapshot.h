@@ -0,0 +1,305 @@
+#ifndef _SKETCH_SNAPSHOT_H_
+#define _SKETCH_SNAPSHOT_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "BOBHash32.h"
+
+// Binary snapshots of the bucket-based sketches (2FASketch, Elastic, 1FA),
+// so that sketches built on many capture boxes can be shipped to one place
+// and merged there.
+//
+// Layout: a 64-byte SnapshotHeader, then the buckets, then the light part
+// counters (Elastic only, stored raw). The buckets are encoded in one of two
+// ways:
+//  SNAPSHOT_RAW     the in-memory Bucket array as it is. It is 64-byte
+//                   aligned in the file, so a Dynamic_2FASketch can map it
+//                   in place (load_mapped).
+//  SNAPSHOT_VARINT  each counter as a LEB128 varint, followed by its 4-byte
+//                   key only if the counter is not 0. Empty and small
+//                   counters take one byte instead of eight.
+// Integers are little endian. Readers reject any other version.
+//
+// Hash seeds are part of the snapshot. Only sketches with the same seed and
+// geometry can be merged, so sketches meant for merging must be constructed
+// with an explicit seed instead of SKETCH_RANDOM_SEED.
+
+#define SNAPSHOT_MAGIC 0x4e534b53 // "SKSN"
+#define SNAPSHOT_VERSION 1
+
+enum SnapshotEncoding
+{
+	SNAPSHOT_RAW = 0,
+	SNAPSHOT_VARINT = 1
+};
+
+enum SnapshotAlgo
+{
+	SNAPSHOT_2FA = 1,
+	SNAPSHOT_ELASTIC = 2,
+	SNAPSHOT_1FA = 3
+};
+
+struct SnapshotHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t encoding;
+	uint32_t algo;
+	uint32_t seed;				// BOBHash32 prime index
+	uint64_t bucket_num;
+	uint32_t counter_per_bucket;
+	int32_t thres_set;
+	uint64_t light_bytes;		// light part counters after the buckets
+	uint64_t payload_bytes;		// bytes after the header
+	uint8_t reserved[16];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "the buckets must stay 64-byte aligned in the file");
+
+// seed of the sketch constructors that draws a random one, as before
+#define SKETCH_RANDOM_SEED 0xFFFFFFFFu
+
+static inline uint32_t sketch_seed(uint32_t seed)
+{
+	return seed == SKETCH_RANDOM_SEED ? BOBHash32::get_random_prime_index() : seed % MAX_PRIME32;
+}
+
+/* encoding */
+static inline void snapshot_put_varint(std::vector<uint8_t> &out, uint32_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+static inline bool snapshot_get_varint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+	v = 0;
+	for (int shift = 0; shift < 35 && p < end; shift += 7)
+	{
+		uint8_t b = *p++;
+		v |= (uint32_t)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// starts a snapshot in out; snapshot_finish fills in the payload size
+static inline void snapshot_begin(std::vector<uint8_t> &out, uint32_t algo, int encoding, uint32_t seed,
+								  uint64_t bucket_num, uint32_t counter_per_bucket, int thres_set, uint64_t light_bytes = 0)
+{
+	SnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = SNAPSHOT_MAGIC;
+	h.version = SNAPSHOT_VERSION;
+	h.encoding = (uint16_t)encoding;
+	h.algo = algo;
+	h.seed = seed;
+	h.bucket_num = bucket_num;
+	h.counter_per_bucket = counter_per_bucket;
+	h.thres_set = thres_set;
+	h.light_bytes = light_bytes;
+	out.clear();
+	out.insert(out.end(), (const uint8_t *)&h, (const uint8_t *)(&h + 1));
+}
+
+static inline void snapshot_finish(std::vector<uint8_t> &out)
+{
+	uint64_t payload = out.size() - sizeof(SnapshotHeader);
+	memcpy(out.data() + offsetof(SnapshotHeader, payload_bytes), &payload, sizeof(payload));
+}
+
+// buckets: bucket_num buckets of counter_per_bucket keys then as many counters
+static inline void snapshot_put_buckets(std::vector<uint8_t> &out, const void *buckets, uint64_t bucket_num,
+										uint32_t counter_per_bucket, int encoding)
+{
+	const uint32_t *words = (const uint32_t *)buckets;
+	if (encoding == SNAPSHOT_RAW)
+	{
+		out.insert(out.end(), (const uint8_t *)words, (const uint8_t *)(words + bucket_num * 2 * counter_per_bucket));
+		return;
+	}
+	for (uint64_t i = 0; i < bucket_num; ++i, words += 2 * counter_per_bucket)
+		for (uint32_t j = 0; j < counter_per_bucket; ++j)
+		{
+			uint32_t val = words[counter_per_bucket + j];
+			snapshot_put_varint(out, val);
+			if (val != 0)
+				out.insert(out.end(), (const uint8_t *)&words[j], (const uint8_t *)&words[j + 1]);
+		}
+}
+
+static inline bool snapshot_get_buckets(const uint8_t *&p, const uint8_t *end, void *buckets, uint64_t bucket_num,
+										uint32_t counter_per_bucket, int encoding)
+{
+	uint32_t *words = (uint32_t *)buckets;
+	if (encoding == SNAPSHOT_RAW)
+	{
+		size_t bytes = bucket_num * 2 * counter_per_bucket * sizeof(uint32_t);
+		if ((size_t)(end - p) < bytes)
+			return false;
+		memcpy(words, p, bytes);
+		p += bytes;
+		return true;
+	}
+	for (uint64_t i = 0; i < bucket_num; ++i, words += 2 * counter_per_bucket)
+		for (uint32_t j = 0; j < counter_per_bucket; ++j)
+		{
+			uint32_t val;
+			if (!snapshot_get_varint(p, end, val))
+				return false;
+			words[counter_per_bucket + j] = val;
+			words[j] = 0;
+			if (val != 0)
+			{
+				if (end - p < 4)
+					return false;
+				memcpy(&words[j], p, 4);
+				p += 4;
+			}
+		}
+	return true;
+}
+
+// the header of data if it is a snapshot of algo with this geometry, else NULL
+static inline const SnapshotHeader *snapshot_check(const uint8_t *data, size_t len, uint32_t algo,
+												   uint64_t bucket_num, uint32_t counter_per_bucket)
+{
+	if (len < sizeof(SnapshotHeader))
+		return NULL;
+	const SnapshotHeader *h = (const SnapshotHeader *)data;
+	if (h->magic != SNAPSHOT_MAGIC || h->version != SNAPSHOT_VERSION || h->algo != algo)
+		return NULL;
+	if (h->bucket_num != bucket_num || h->counter_per_bucket != counter_per_bucket || h->seed >= MAX_PRIME32)
+		return NULL;
+	if (h->encoding != SNAPSHOT_RAW && h->encoding != SNAPSHOT_VARINT)
+		return NULL;
+	if (h->payload_bytes != len - sizeof(SnapshotHeader))
+		return NULL;
+	// a raw payload may be mapped in place, so it must hold every bucket
+	uint64_t bucket_bytes = bucket_num * counter_per_bucket * 2 * sizeof(uint32_t);
+	if (h->encoding == SNAPSHOT_RAW
+		&& (h->payload_bytes < bucket_bytes || h->payload_bytes - bucket_bytes != h->light_bytes))
+		return NULL;
+	return h;
+}
+
+/* merging */
+
+// Merges the valid slots of bucket b into bucket a (valid counters each,
+// laid out as in Bucket). Keys in both get the sum of their counters, and a
+// keeps the largest counters of the union. The others are passed to
+// evict(key, val). Counters are compared and added under val_mask, and the
+// bits outside it are or-ed, e.g. Elastic's flag bit.
+template<typename Evict>
+static void bucket_merge(uint32_t *a_key, uint32_t *a_val, const uint32_t *b_key, const uint32_t *b_val,
+						 int valid, uint32_t val_mask, Evict &&evict)
+{
+	uint32_t keys[64], vals[64];
+	int n = 0;
+	for (int i = 0; i < valid; ++i)
+		if (a_val[i] != 0)
+		{
+			keys[n] = a_key[i];
+			vals[n++] = a_val[i];
+		}
+	for (int i = 0; i < valid; ++i)
+	{
+		if (b_val[i] == 0)
+			continue;
+		int j = 0;
+		while (j < n && keys[j] != b_key[i])
+			++j;
+		if (j == n)
+		{
+			keys[n] = b_key[i];
+			vals[n++] = b_val[i];
+			continue;
+		}
+		vals[j] = (((vals[j] & val_mask) + (b_val[i] & val_mask)) & val_mask) | ((vals[j] | b_val[i]) & ~val_mask);
+	}
+
+	// largest counters first, at most 2 * valid entries
+	for (int i = 0; i < n && i < valid; ++i)
+	{
+		int best = i;
+		for (int j = i + 1; j < n; ++j)
+			if ((vals[j] & val_mask) > (vals[best] & val_mask))
+				best = j;
+		std::swap(keys[i], keys[best]);
+		std::swap(vals[i], vals[best]);
+	}
+	for (int i = 0; i < valid; ++i)
+	{
+		a_key[i] = i < n ? keys[i] : 0;
+		a_val[i] = i < n ? vals[i] : 0;
+	}
+	for (int i = valid; i < n; ++i)
+		evict(keys[i], vals[i]);
+}
+
+/* files */
+static inline bool snapshot_save(const char *path, const std::vector<uint8_t> &data)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return fclose(f) == 0 && ok;
+}
+
+// Maps a snapshot file copy-on-write: it can be read in place and written to
+// without touching the file. populate reads the whole file in up front;
+// without it, pages are read when first touched. Returns NULL if it cannot
+// be opened or mapped.
+static inline uint8_t *snapshot_map(const char *path, size_t &size, bool populate = true)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	size = st.st_size;
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+	close(fd);
+	return p == MAP_FAILED ? NULL : (uint8_t *)p;
+}
+
+// sketch.deserialize() of the snapshot file at path
+template<typename Sketch>
+bool sketch_load(Sketch &sketch, const char *path)
+{
+	size_t size;
+	uint8_t *data = snapshot_map(path, size);
+	if (!data)
+		return false;
+	bool ok = sketch.deserialize(data, size);
+	munmap(data, size);
+	return ok;
+}
+
+template<typename Sketch>
+bool sketch_save(Sketch &sketch, const char *path, int encoding = SNAPSHOT_RAW)
+{
+	std::vector<uint8_t> data;
+	sketch.serialize(data, encoding);
+	return snapshot_save(path, data);
+}
+
+#endif
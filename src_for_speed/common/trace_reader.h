@@ -0,0 +1,94 @@
+#ifndef _TRACE_READER_H_
+#define _TRACE_READER_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+
+// flags of MappedTrace::open
+#define TRACE_SEQUENTIAL 1 // madvise(MADV_SEQUENTIAL), read-ahead for one pass
+#define TRACE_POPULATE 2   // MAP_POPULATE, fault every page in before open returns
+
+// A trace file of fixed-size records (the 13-byte FIVE_TUPLEs of the .dat
+// files) mapped read-only into memory. Records are used in place: no copy
+// into a vector, and the pages are shared with the page cache. data() with
+// a stride of sizeof(T) can be handed straight to the insert_batch APIs.
+//
+// TRACE_POPULATE is on by default so the timed insert loops of the speed
+// demos do not pay the page faults.
+template<typename T>
+class MappedTrace
+{
+	const T *records = NULL;
+	size_t record_num = 0;
+	size_t map_size = 0;
+
+	MappedTrace(const MappedTrace &);
+	MappedTrace &operator=(const MappedTrace &);
+
+public:
+	MappedTrace(){}
+	~MappedTrace()
+	{
+		clear();
+	}
+
+	// returns false if the file cannot be opened or mapped; a trailing
+	// partial record is ignored, like the fread loops did
+	bool open(const char *path, int flags = TRACE_SEQUENTIAL | TRACE_POPULATE)
+	{
+		clear();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			return false;
+		}
+		record_num = st.st_size / sizeof(T);
+		if (record_num == 0)
+		{
+			close(fd);
+			return true;
+		}
+
+		map_size = st.st_size;
+		int map_flags = MAP_PRIVATE;
+		if (flags & TRACE_POPULATE)
+			map_flags |= MAP_POPULATE;
+		void *p = mmap(NULL, map_size, PROT_READ, map_flags, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+		{
+			record_num = map_size = 0;
+			return false;
+		}
+		if (flags & TRACE_SEQUENTIAL)
+			madvise(p, map_size, MADV_SEQUENTIAL);
+
+		records = (const T *)p;
+		return true;
+	}
+
+	void clear()
+	{
+		if (records)
+			munmap((void *)records, map_size);
+		records = NULL;
+		record_num = map_size = 0;
+	}
+
+	size_t size() const { return record_num; }
+	const T *data() const { return records; }
+	const T &operator[](size_t i) const { return records[i]; }
+	const T *begin() const { return records; }
+	const T *end() const { return records + record_num; }
+};
+
+#endif
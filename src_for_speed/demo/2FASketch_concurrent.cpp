@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "../2FASketch/2FASketch.h"
+#include "../2FASketch/Concurrent2FASketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define MEMORY_NUMBER 100
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+#define MAX_THREAD_NUM 8
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+
+#define TOT_MEM_IN_BYTES (MEMORY_NUMBER * 1024)
+#define BUCKET_NUM (TOT_MEM_IN_BYTES/sizeof(Bucket))
+typedef Elastic_2FASketch<BUCKET_NUM> SKETCH;
+typedef Concurrent_2FASketch<BUCKET_NUM> CONCURRENT_SKETCH;
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+
+//argv[1]:out_file
+//argv[2]:label_name
+//output: label,thread_num,Mpps
+//thread_num 0 is the unsynchronized Elastic_2FASketch, the baseline of the
+//one-thread cost of the atomics; the others share one Concurrent_2FASketch,
+//each thread inserting a contiguous slice of the trace
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+
+	for(int thread_num = 0; thread_num <= MAX_THREAD_NUM; thread_num = thread_num ? thread_num * 2 : 1)
+	{
+		double total_mpps = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			const TRACE &trace = traces[datafileCnt - 1];
+			int packet_cnt=(int)trace.size();
+			double threshold=HEAVY_HITTER_THRESHOLD(packet_cnt);
+			double total_time;
+
+			if(thread_num == 0)
+			{
+				SKETCH *E_2FA = new SKETCH(threshold * 0.5);
+				auto start_time = chrono::steady_clock::now();
+				E_2FA->insert_batch((const uint8_t*)trace.data(), packet_cnt, sizeof(FIVE_TUPLE));
+				auto end_time = chrono::steady_clock::now();
+				total_time = chrono::duration<double>(end_time - start_time).count();
+				delete E_2FA;
+			}
+			else
+			{
+				CONCURRENT_SKETCH *E_2FA = new CONCURRENT_SKETCH(threshold * 0.5);
+				auto start_time = chrono::steady_clock::now();
+				vector<thread> workers;
+				for(int tid = 0; tid < thread_num; ++tid)
+					workers.emplace_back([&, tid]{
+						size_t begin = (size_t)packet_cnt * tid / thread_num;
+						size_t end = (size_t)packet_cnt * (tid + 1) / thread_num;
+						E_2FA->insert_batch((const uint8_t*)(trace.data() + begin), end - begin, sizeof(FIVE_TUPLE));
+					});
+				for(auto &w : workers)
+					w.join();
+				auto end_time = chrono::steady_clock::now();
+				total_time = chrono::duration<double>(end_time - start_time).count();
+				delete E_2FA;
+			}
+
+			total_mpps += (double)packet_cnt/total_time/1000000;
+		}
+		fout<<argv[2]<<","<<thread_num<<","<<total_mpps/(END_FILE_NO - START_FILE_NO + 1)<<endl;
+		printf("%d threads%s: %f Mpps\n", thread_num, thread_num ? "" : " (unsynchronized)", total_mpps/(END_FILE_NO - START_FILE_NO + 1));
+	}
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include<time.h>
+#include "../2FASketch/Dynamic2FASketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+//argv[1]:out_file
+//argv[2]:label_name
+//argv[3...]:memory sizes in KB, default 16KB to 512MB
+//set HUGEPAGE=1 in the environment to back the buckets with 2MB pages
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+	bool use_hugepage = getenv("HUGEPAGE") && atoi(getenv("HUGEPAGE"));
+
+	vector<long> mem_list;
+	for(int i = 3; i < argc; ++i)
+		mem_list.push_back(atol(argv[i]));
+	if(mem_list.empty())
+		mem_list = {16, 100, 1024, 8 * 1024, 64 * 1024, 512 * 1024};
+
+	for(long mem_kb : mem_list)
+	{
+		double total_mpps = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			int packet_cnt=(int)traces[datafileCnt - 1].size();
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+			double threshold=HEAVY_HITTER_THRESHOLD(packet_cnt);
+			Dynamic_2FASketch *E_2FA = new Dynamic_2FASketch(mem_kb * 1024, threshold * 0.5, use_hugepage);
+
+			double start_time=clock();
+			E_2FA->insert_batch((const uint8_t*)traces[datafileCnt-1].data(), packet_cnt, sizeof(FIVE_TUPLE));
+			double end_time=clock();
+			double total_time=((double)(end_time-start_time))/CLOCKS_PER_SEC;
+
+			total_mpps += (double)packet_cnt/total_time/1000000;
+			delete E_2FA;
+		}
+		total_mpps /= (END_FILE_NO - START_FILE_NO + 1);
+		fout<<argv[2]<<","<<((double)mem_kb)/1000<<","<<total_mpps<<endl;
+		printf("%ldKB: %f Mpps\n", mem_kb, total_mpps);
+	}
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include "../2FASketch/Dynamic2FASketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+//argv[1]:out_file
+//argv[2]:label_name
+//argv[3...]:memory sizes in KB, default 1MB to 512MB
+//output: label,memory(MB),pages requested,pages obtained,Mpps
+//every size is run with 4KB pages, transparent hugepages, and reserved 2MB
+//and 1GB pages (see common/sketch_alloc.h); a request the kernel cannot
+//serve falls back to smaller pages, shown by "pages obtained". Set
+//SKETCH_NUMA_NODE to bind the buckets to a node.
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+
+	vector<long> mem_list;
+	for(int i = 3; i < argc; ++i)
+		mem_list.push_back(atol(argv[i]));
+	if(mem_list.empty())
+		mem_list = {1024, 8 * 1024, 64 * 1024, 512 * 1024};
+
+	for(long mem_kb : mem_list)
+	{
+		for(int pages = SKETCH_PAGES_DEFAULT; pages <= SKETCH_PAGES_1G; ++pages)
+		{
+			SketchAllocPolicy policy = sketch_alloc_policy();
+			policy.pages = pages;
+			int obtained = pages;
+			double total_mpps = 0;
+			for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+			{
+				int packet_cnt=(int)traces[datafileCnt - 1].size();
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+				double threshold=HEAVY_HITTER_THRESHOLD(packet_cnt);
+				Dynamic_2FASketch *E_2FA = new Dynamic_2FASketch(mem_kb * 1024, threshold * 0.5, policy);
+				obtained = E_2FA->get_pages();
+
+				auto start_time = chrono::steady_clock::now();
+				E_2FA->insert_batch((const uint8_t*)traces[datafileCnt-1].data(), packet_cnt, sizeof(FIVE_TUPLE));
+				auto end_time = chrono::steady_clock::now();
+
+				total_mpps += (double)packet_cnt/chrono::duration<double>(end_time - start_time).count()/1000000;
+				delete E_2FA;
+			}
+			total_mpps /= (END_FILE_NO - START_FILE_NO + 1);
+			fout<<argv[2]<<","<<((double)mem_kb)/1000<<","<<sketch_pages_name(pages)<<","<<sketch_pages_name(obtained)<<","<<total_mpps<<endl;
+			printf("%ldKB, %s pages (got %s): %f Mpps\n", mem_kb, sketch_pages_name(pages), sketch_pages_name(obtained), total_mpps);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "../2FASketch/Sharded2FASketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define MEMORY_NUMBER 100
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+#define SHARD_NUM 8
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+//argv[1]:out_file
+//argv[2]:label_name
+//output: label,thread_num,Mpps
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+#define TOT_MEM_IN_BYTES (MEMORY_NUMBER * 1024)
+#define SHARD_BUCKET_NUM (TOT_MEM_IN_BYTES/sizeof(Bucket)/SHARD_NUM)
+	typedef Sharded_2FASketch<SHARD_BUCKET_NUM, SHARD_NUM> SKETCH;
+	fout.open(argv[1],ios::app);
+
+	for(int thread_num = 1; thread_num <= SHARD_NUM; thread_num *= 2)
+	{
+		double total_mpps = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			int packet_cnt=(int)traces[datafileCnt - 1].size();
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+			double threshold=HEAVY_HITTER_THRESHOLD(packet_cnt);
+			SKETCH *E_2FA = new SKETCH(threshold * 0.5);
+
+			// split the trace the way RSS would, one queue per shard
+			vector<FIVE_TUPLE> queues[SHARD_NUM];
+			for(int i = 0; i < packet_cnt; ++i)
+			{
+				const FIVE_TUPLE &t = traces[datafileCnt-1][i];
+				queues[SKETCH::get_shard((uint8_t*)t.key)].push_back(t);
+			}
+
+			auto start_time = chrono::steady_clock::now();
+			vector<thread> workers;
+			for(int tid = 0; tid < thread_num; ++tid)
+				workers.emplace_back([&, tid]{
+					for(int s = tid; s < SHARD_NUM; s += thread_num)
+						E_2FA->insert_batch(s, (const uint8_t*)queues[s].data(), queues[s].size(), sizeof(FIVE_TUPLE));
+				});
+			for(auto &w : workers)
+				w.join();
+			auto end_time = chrono::steady_clock::now();
+			double total_time = chrono::duration<double>(end_time - start_time).count();
+
+			total_mpps += (double)packet_cnt/total_time/1000000;
+			delete E_2FA;
+		}
+		fout<<argv[2]<<","<<thread_num<<","<<total_mpps/(END_FILE_NO - START_FILE_NO + 1)<<endl;
+		printf("%d threads: %f Mpps\n", thread_num, total_mpps/(END_FILE_NO - START_FILE_NO + 1));
+	}
+}
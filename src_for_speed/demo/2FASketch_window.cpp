@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "../2FASketch/2FASketch.h"
+#include "../2FASketch/Windowed2FASketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define MEMORY_NUMBER (8 * 1024)
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+#define WINDOW_NUM 3
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+
+#define TOT_MEM_IN_BYTES (MEMORY_NUMBER * 1024)
+#define BUCKET_NUM (TOT_MEM_IN_BYTES/sizeof(Bucket))
+typedef Elastic_2FASketch<BUCKET_NUM> SKETCH;
+typedef Windowed_2FASketch<BUCKET_NUM, WINDOW_NUM> WINDOWED_SKETCH;
+
+#define HEAVY_HITTER_THRESHOLD(total_packet) (total_packet * 1 / 10000)
+static uint32_t hh_keys[1 << 16];
+static int hh_counts[1 << 16];
+
+// one sketch, queried and cleared by the inserting thread at every window
+// end; adds the time spent between windows to stall_us
+double run_clear(const TRACE &trace, int window_packets, double &stall_us)
+{
+	int packet_cnt=(int)trace.size();
+	int threshold=HEAVY_HITTER_THRESHOLD(window_packets);
+	SKETCH *E_2FA = new SKETCH(threshold * 0.5);
+	size_t reported = 0;
+
+	auto start_time = chrono::steady_clock::now();
+	for(int i = 0; i < packet_cnt; i += window_packets)
+	{
+		int n = min(window_packets, packet_cnt - i);
+		E_2FA->insert_batch((const uint8_t*)(trace.data() + i), n, sizeof(FIVE_TUPLE));
+		auto stall_start = chrono::steady_clock::now();
+		reported += E_2FA->get_heavy_hitters(threshold, hh_keys, hh_counts, 1 << 16);
+		E_2FA->clear();
+		stall_us += chrono::duration<double, micro>(chrono::steady_clock::now() - stall_start).count();
+	}
+	auto end_time = chrono::steady_clock::now();
+	delete E_2FA;
+	if(reported == 0)
+		printf("no heavy hitters reported\n");
+	return (double)packet_cnt/chrono::duration<double>(end_time - start_time).count()/1000000;
+}
+
+// a ring of windows: the inserting thread only rotates, a reporter thread
+// drains and releases the closed windows
+double run_ring(const TRACE &trace, int window_packets, double &stall_us, uint64_t &sync_clears)
+{
+	int packet_cnt=(int)trace.size();
+	int threshold=HEAVY_HITTER_THRESHOLD(window_packets);
+	WINDOWED_SKETCH *E_2FA = new WINDOWED_SKETCH(threshold * 0.5);
+	std::atomic<bool> done(false);
+	size_t reported = 0;
+
+	thread reporter([&]{
+		uint64_t next = 0;
+		while(true)
+		{
+			bool finished = done.load();
+			for(; next < E_2FA->current_epoch(); ++next)
+			{
+				if(!E_2FA->is_readable(next))
+					continue;
+				reported += E_2FA->get_heavy_hitters(next, threshold, hh_keys, hh_counts, 1 << 16);
+				E_2FA->release(next);
+			}
+			if(finished)
+				break;
+			this_thread::yield();
+		}
+	});
+
+	auto start_time = chrono::steady_clock::now();
+	for(int i = 0; i < packet_cnt; i += window_packets)
+	{
+		int n = min(window_packets, packet_cnt - i);
+		E_2FA->insert_batch((const uint8_t*)(trace.data() + i), n, sizeof(FIVE_TUPLE));
+		auto stall_start = chrono::steady_clock::now();
+		E_2FA->rotate();
+		stall_us += chrono::duration<double, micro>(chrono::steady_clock::now() - stall_start).count();
+	}
+	auto end_time = chrono::steady_clock::now();
+	done.store(true);
+	reporter.join();
+	sync_clears += E_2FA->get_sync_clears();
+	delete E_2FA;
+	if(reported == 0)
+		printf("no heavy hitters reported\n");
+	return (double)packet_cnt/chrono::duration<double>(end_time - start_time).count()/1000000;
+}
+
+//argv[1]:out_file
+//argv[2]:label_name
+//argv[3...]:packets per window, default 10000 to 1000000
+//output: label,window_packets,clear_Mpps,ring_Mpps,clear_stall_us,ring_stall_us
+//the stalls are the average time the inserting thread spends between two
+//windows; the ring only stalls when the reporter is late releasing a window
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+
+	vector<int> window_list;
+	for(int i = 3; i < argc; ++i)
+		window_list.push_back(atoi(argv[i]));
+	if(window_list.empty())
+		window_list = {10000, 100000, 1000000};
+
+	for(int window_packets : window_list)
+	{
+		double clear_mpps = 0, ring_mpps = 0, clear_stall_us = 0, ring_stall_us = 0;
+		uint64_t sync_clears = 0;
+		size_t window_cnt = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			clear_mpps += run_clear(traces[datafileCnt - 1], window_packets, clear_stall_us);
+			ring_mpps += run_ring(traces[datafileCnt - 1], window_packets, ring_stall_us, sync_clears);
+			window_cnt += (traces[datafileCnt - 1].size() + window_packets - 1) / window_packets;
+		}
+		clear_mpps /= (END_FILE_NO - START_FILE_NO + 1);
+		ring_mpps /= (END_FILE_NO - START_FILE_NO + 1);
+		clear_stall_us /= window_cnt;
+		ring_stall_us /= window_cnt;
+		fout<<argv[2]<<","<<window_packets<<","<<clear_mpps<<","<<ring_mpps<<","<<clear_stall_us<<","<<ring_stall_us<<endl;
+		printf("%d packets per window: clear %f Mpps, %f us per window end; ring %f Mpps, %f us per rotation (%lu rotations cleared a window)\n",
+			window_packets, clear_mpps, clear_stall_us, ring_mpps, ring_stall_us, (unsigned long)sync_clears);
+	}
+}
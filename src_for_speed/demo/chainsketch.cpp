@@ -6,6 +6,7 @@
 #include <vector>
 #include<time.h>
 #include "../chainsketch/chainsketch.h"
+#include "../common/trace_reader.h"
 using namespace std;
 
 #define MEMORY_NUMBER 100
@@ -14,7 +15,7 @@ using namespace std;
 
 
 struct FIVE_TUPLE{	char key[13];	};
-typedef vector<FIVE_TUPLE> TRACE;
+typedef MappedTrace<FIVE_TUPLE> TRACE;
 TRACE traces[END_FILE_NO - START_FILE_NO + 1];
 
 void ReadInTraces(const char *trace_prefix)
@@ -23,14 +24,11 @@ void ReadInTraces(const char *trace_prefix)
 	{
 		char datafileName[100];
 		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
-		FILE *fin = fopen(datafileName, "rb");
-
-		FIVE_TUPLE tmp_five_tuple;
-		while(fread(&tmp_five_tuple, 1, 13, fin) == 13)
+		if(!traces[datafileCnt-1].open(datafileName))
 		{
-			traces[datafileCnt-1].push_back(tmp_five_tuple);
+			printf("cannot open %s\n", datafileName);
+			exit(1);
 		}
-		fclose(fin);
 
 	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
 
@@ -55,10 +53,7 @@ int main(int argc,char* argv[])
 		chainsketch = new ChainSketch<TOT_MEM_IN_BYTES>();
 		int packet_cnt=(int)traces[datafileCnt - 1].size();
 		start_time=clock();
-		for(int i = 0; i < packet_cnt; ++i)
-		{
-			chainsketch->insert((uint8_t*)(traces[datafileCnt-1][i].key));
-		}
+		chainsketch->insert_batch((const uint8_t*)traces[datafileCnt-1].data(), packet_cnt, sizeof(FIVE_TUPLE));
   
 		end_time=clock();
 	 	total_time=((double)(end_time-start_time))/CLOCKS_PER_SEC;	
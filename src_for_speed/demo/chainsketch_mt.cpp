@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "../chainsketch/chainsketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define MEMORY_NUMBER 100
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+#define MAX_THREAD_NUM 8
+#define SEED 7
+
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+//argv[1]:out_file
+//argv[2]:label_name
+//output: label,thread_num,Mpps
+//every thread inserts a slice of the trace into its own ChainSketch, all
+//with the same seed; the time includes merging them into the first one
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+#define TOT_MEM_IN_BYTES (MEMORY_NUMBER * 1024)
+	typedef ChainSketch<TOT_MEM_IN_BYTES> SKETCH;
+	fout.open(argv[1],ios::app);
+
+	for(int thread_num = 1; thread_num <= MAX_THREAD_NUM; thread_num *= 2)
+	{
+		double total_mpps = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			int packet_cnt=(int)traces[datafileCnt - 1].size();
+			const FIVE_TUPLE *trace = traces[datafileCnt - 1].data();
+			vector<SKETCH*> sketches;
+			for(int tid = 0; tid < thread_num; ++tid)
+				sketches.push_back(new SKETCH(4, SEED));
+
+			auto start_time = chrono::steady_clock::now();
+			vector<thread> workers;
+			for(int tid = 0; tid < thread_num; ++tid)
+				workers.emplace_back([&, tid]{
+					int begin = (long)packet_cnt * tid / thread_num, end = (long)packet_cnt * (tid + 1) / thread_num;
+					sketches[tid]->insert_batch((const uint8_t*)(trace + begin), end - begin, sizeof(FIVE_TUPLE));
+				});
+			for(auto &w : workers)
+				w.join();
+			for(int tid = 1; tid < thread_num; ++tid)
+				sketches[0]->merge(*sketches[tid]);
+			auto end_time = chrono::steady_clock::now();
+			double total_time = chrono::duration<double>(end_time - start_time).count();
+
+			total_mpps += (double)packet_cnt/total_time/1000000;
+			for(SKETCH *s : sketches)
+				delete s;
+		}
+		fout<<argv[2]<<","<<thread_num<<","<<total_mpps/(END_FILE_NO - START_FILE_NO + 1)<<endl;
+		printf("%d threads: %f Mpps\n", thread_num, total_mpps/(END_FILE_NO - START_FILE_NO + 1));
+	}
+}
@@ -5,5 +5,7 @@
 ./elastic.out Speed.txt Elastic
 ./1FA.out Speed.txt 1FA
 ./2FASketch.out Speed.txt 2FASketch
+./2FASketch_mt.out Speed_threads.txt 2FASketch
+./2FASketch_dynamic.out Speed_sweep.txt 2FASketch
 ./spacesaving.out Speed.txt SS
 ./chainsketch.out Speed.txt chainsketch
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <unordered_set>
+#include <chrono>
+#include "../elastic/ElasticSketch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+
+// a light part of a few MB, the size exported per measurement epoch
+#define BUCKET_NUM (1024 * 1024 / 64)
+#define TOT_MEM_IN_BYTES (5 * 1024 * 1024)
+#define LIGHT_MEM (TOT_MEM_IN_BYTES - BUCKET_NUM * 64)
+#define COMPRESS_REPEAT 20
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+typedef ElasticSketch<BUCKET_NUM, TOT_MEM_IN_BYTES> SKETCH;
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+
+// the strided compression LightPart::compress used to do
+static void compress_strided(const uint8_t *counters, int counter_num, int width, uint8_t *dst)
+{
+	for (int i = 0; i < width && i < counter_num; ++i)
+	{
+		uint8_t max_val = 0;
+		for (int j = i; j < counter_num; j += width)
+			max_val = counters[j] > max_val ? counters[j] : max_val;
+		dst[i] = max_val;
+	}
+}
+
+//argv[1]:out_file
+//argv[2]:label_name
+//argv[3...]:compression ratios, default 1 to 32
+//output: label,ratio,strided compress GB/s,compress GB/s,query Mqps,batched query Mqps
+//GB/s is of light part counters read; queries are of the sketch with the
+//compressed light part, once for every flow of a trace, as a collector would
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+
+	vector<int> ratio_list;
+	for(int i = 3; i < argc; ++i)
+		ratio_list.push_back(atoi(argv[i]));
+	if(ratio_list.empty())
+		ratio_list = {1, 2, 4, 8, 16, 32};
+
+	for(int ratio : ratio_list)
+	{
+		double strided_gbps = 0, compress_gbps = 0, query_mqps = 0, batch_mqps = 0;
+		for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+		{
+			int packet_cnt = (int)traces[datafileCnt-1].size();
+			const uint8_t *keys = (const uint8_t*)traces[datafileCnt-1].data();
+			SKETCH *elastic = new SKETCH();
+			for(int i = 0; i < packet_cnt; ++i)
+				elastic->insert((uint8_t*)(keys + i * sizeof(FIVE_TUPLE)));
+
+			// the light counters follow the buckets in a raw snapshot
+			vector<uint8_t> snapshot;
+			elastic->serialize(snapshot);
+			const uint8_t *counters = snapshot.data() + snapshot.size() - LIGHT_MEM;
+
+			int width = elastic->get_compress_width(ratio);
+			vector<uint8_t> ref(width), dst(width);
+
+			auto t1 = chrono::steady_clock::now();
+			for(int r = 0; r < COMPRESS_REPEAT; ++r)
+				compress_strided(counters, LIGHT_MEM, width, ref.data());
+			auto t2 = chrono::steady_clock::now();
+			for(int r = 0; r < COMPRESS_REPEAT; ++r)
+				elastic->compress(ratio, dst.data());
+			auto t3 = chrono::steady_clock::now();
+			if(ref != dst)
+			{
+				printf("ratio %d: compressed counters differ\n", ratio);
+				exit(1);
+			}
+			double bytes = (double)LIGHT_MEM * COMPRESS_REPEAT;
+			strided_gbps += bytes / chrono::duration<double>(t2 - t1).count() / 1e9;
+			compress_gbps += bytes / chrono::duration<double>(t3 - t2).count() / 1e9;
+
+			unordered_set<uint32_t> flow_set;
+			for(int i = 0; i < packet_cnt; ++i)
+				flow_set.insert(*(const uint32_t*)(keys + i * sizeof(FIVE_TUPLE)));
+			vector<uint32_t> flows(flow_set.begin(), flow_set.end());
+			int flow_cnt = (int)flows.size();
+
+			vector<int> results(flow_cnt), batch_results(flow_cnt);
+			t1 = chrono::steady_clock::now();
+			for(int i = 0; i < flow_cnt; ++i)
+				results[i] = elastic->query_compressed_part((uint8_t*)&flows[i], dst.data(), width);
+			t2 = chrono::steady_clock::now();
+			elastic->query_compressed_batch((const uint8_t*)flows.data(), flow_cnt, sizeof(uint32_t), dst.data(), width, batch_results.data());
+			t3 = chrono::steady_clock::now();
+			if(results != batch_results)
+			{
+				printf("ratio %d: batched queries differ\n", ratio);
+				exit(1);
+			}
+			query_mqps += flow_cnt / chrono::duration<double>(t2 - t1).count() / 1e6;
+			batch_mqps += flow_cnt / chrono::duration<double>(t3 - t2).count() / 1e6;
+			delete elastic;
+		}
+		int file_num = END_FILE_NO - START_FILE_NO + 1;
+		strided_gbps /= file_num, compress_gbps /= file_num, query_mqps /= file_num, batch_mqps /= file_num;
+		fout<<argv[2]<<","<<ratio<<","<<strided_gbps<<","<<compress_gbps<<","<<query_mqps<<","<<batch_mqps<<endl;
+		printf("ratio %d: compress %f GB/s (strided %f), query %f Mqps (batched %f)\n", ratio, compress_gbps, strided_gbps, query_mqps, batch_mqps);
+	}
+}
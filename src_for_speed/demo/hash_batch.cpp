@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include<iostream>
+#include<fstream>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include "../common/hash_batch.h"
+#include "../common/trace_reader.h"
+using namespace std;
+
+#define START_FILE_NO 1
+#define END_FILE_NO 10
+
+#define SEED_NUM 16
+
+struct FIVE_TUPLE{	char key[13];	};
+typedef MappedTrace<FIVE_TUPLE> TRACE;
+TRACE traces[END_FILE_NO - START_FILE_NO + 1];
+
+void ReadInTraces(const char *trace_prefix)
+{
+	for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+	{
+		char datafileName[100];
+		sprintf(datafileName,"%s%d.dat",trace_prefix,datafileCnt-1);
+		if(!traces[datafileCnt-1].open(datafileName))
+		{
+			printf("cannot open %s\n", datafileName);
+			exit(1);
+		}
+
+	printf("Successfully read in %s, %ld packets\n", datafileName, traces[datafileCnt-1].size());
+
+	}
+	printf("\n");
+}
+
+// keys: the source IPs in place (what the sketches hash), the same packed
+// into 4-byte keys, or the whole five tuples
+struct KeySet
+{
+	const char *name;
+	int key_len;
+	int packed;
+};
+
+//argv[1]:out_file
+//argv[2]:label_name
+//output: label,hash,kernel,keys,mode,Mhash/s
+//mode batch is many keys under one seed, seeds is one key under SEED_NUM
+//seeds; the scalar kernel is BOBHash32::run/MurmurHash3 called per key
+int main(int argc,char* argv[])
+{
+	ReadInTraces("../../data/");
+	ofstream fout;
+	fout.open(argv[1],ios::app);
+
+	KeySet key_sets[] = {{"srcip", 4, 0}, {"packed", 4, 1}, {"5tuple", 13, 0}};
+	uint32_t prime_indexes[SEED_NUM], seeds[SEED_NUM];
+	for(int i = 0; i < SEED_NUM; ++i)
+		prime_indexes[i] = 101 + i, seeds[i] = 0x9747b28cu + i;
+
+	for(auto &k : hash_batch_kernels)
+	{
+		if(!hash_batch_supported(k))
+			continue;
+		for(int murmur = 0; murmur < 2; ++murmur)
+		{
+			const char *hash = murmur ? "murmur3" : "bob";
+			for(auto &ks : key_sets)
+			{
+				double batch_mhps = 0, seeds_mhps = 0;
+				uint32_t check = 0;
+				for(int datafileCnt = START_FILE_NO; datafileCnt <= END_FILE_NO; ++datafileCnt)
+				{
+					size_t packet_cnt = traces[datafileCnt-1].size();
+					const uint8_t *keys = (const uint8_t*)traces[datafileCnt-1].data();
+					size_t stride = sizeof(FIVE_TUPLE);
+					vector<uint32_t> packed;
+					if(ks.packed)
+					{
+						packed.resize(packet_cnt);
+						for(size_t i = 0; i < packet_cnt; ++i)
+							memcpy(&packed[i], keys + i * stride, 4);
+						keys = (const uint8_t*)packed.data();
+						stride = 4;
+					}
+					vector<uint32_t> out(packet_cnt);
+
+					auto t1 = chrono::steady_clock::now();
+					if(murmur)
+						k.murmur_batch(keys, packet_cnt, stride, ks.key_len, seeds[0], out.data());
+					else
+						k.bob_batch(keys, packet_cnt, stride, ks.key_len, prime_indexes[0], out.data());
+					auto t2 = chrono::steady_clock::now();
+					batch_mhps += packet_cnt / chrono::duration<double>(t2 - t1).count() / 1e6;
+					check ^= out[packet_cnt / 2];
+
+					// every key under all the seeds, as a sketch with SEED_NUM rows would
+					size_t seed_cnt = packet_cnt / 4;
+					uint32_t row[SEED_NUM], acc = 0;
+					t1 = chrono::steady_clock::now();
+					for(size_t i = 0; i < seed_cnt; ++i)
+					{
+						if(murmur)
+							k.murmur_seeds(keys + i * stride, ks.key_len, seeds, SEED_NUM, row);
+						else
+							k.bob_seeds(keys + i * stride, ks.key_len, prime_indexes, SEED_NUM, row);
+						acc ^= row[i % SEED_NUM];
+					}
+					t2 = chrono::steady_clock::now();
+					seeds_mhps += seed_cnt * SEED_NUM / chrono::duration<double>(t2 - t1).count() / 1e6;
+					check ^= acc;
+				}
+				int file_num = END_FILE_NO - START_FILE_NO + 1;
+				batch_mhps /= file_num, seeds_mhps /= file_num;
+				fout<<argv[2]<<","<<hash<<","<<k.name<<","<<ks.name<<",batch,"<<batch_mhps<<endl;
+				fout<<argv[2]<<","<<hash<<","<<k.name<<","<<ks.name<<",seeds,"<<seeds_mhps<<endl;
+				printf("%s %s %s: batch %f Mhash/s, %d seeds %f Mhash/s (check %08x)\n", hash, k.name, ks.name, batch_mhps, SEED_NUM, seeds_mhps, check);
+			}
+		}
+	}
+}
@@ -15,7 +15,8 @@ class ElasticSketch
     LightPart<light_mem> light_part;
 
 public:
-    ElasticSketch(){}
+    // sketches to be merged must share a seed, see common/sketch_snapshot.h
+    ElasticSketch(uint32_t seed = SKETCH_RANDOM_SEED): light_part(seed){}
     ~ElasticSketch(){}
     void clear()
     {
@@ -73,6 +74,37 @@ public:
         return heavy_result;
     }
 
+    // query_compressed_part of n keys of stride bytes into results; the keys
+    // the heavy part does not answer alone go to the light part in batches
+    void query_compressed_batch(const uint8_t *keys, size_t n, size_t stride, const uint8_t *compress_part,
+                                int compress_counter_num, int *results)
+    {
+        uint32_t light_keys[QUERY_BATCH];
+        int light_results[QUERY_BATCH];
+        size_t light_index[QUERY_BATCH];
+        for(size_t base = 0; base < n; base += QUERY_BATCH)
+        {
+            size_t m = n - base < QUERY_BATCH ? n - base : QUERY_BATCH, light_num = 0;
+            for(size_t i = 0; i < m; ++i)
+                heavy_part.prefetch(keys + (base + i) * stride);
+            for(size_t i = 0; i < m; ++i)
+            {
+                uint8_t *key = (uint8_t*)(keys + (base + i) * stride);
+                uint32_t heavy_result = heavy_part.query(key);
+                results[base + i] = (int)GetCounterVal(heavy_result);
+                if(heavy_result == 0 || HIGHEST_BIT_IS_1(heavy_result))
+                {
+                    light_keys[light_num] = *(uint32_t*)key;
+                    light_index[light_num++] = base + i;
+                }
+            }
+            light_part.query_compressed_batch((const uint8_t*)light_keys, light_num, KEY_LENGTH_4, compress_part,
+                                              compress_counter_num, light_results);
+            for(size_t i = 0; i < light_num; ++i)
+                results[light_index[i]] += light_results[i];
+        }
+    }
+
     void get_heavy_hitters(int threshold, vector<pair<string, int>> & results)
     {
         for (int i = 0; i < bucket_num; ++i) 
@@ -86,6 +118,57 @@ public:
             }
     }
 
+/* snapshots, see common/sketch_snapshot.h; the light part counters follow
+   the buckets */
+    void serialize(vector<uint8_t> &out, int encoding = SNAPSHOT_RAW)
+    {
+        snapshot_begin(out, SNAPSHOT_ELASTIC, encoding, light_part.seed, bucket_num, COUNTER_PER_BUCKET, 0, light_mem);
+        snapshot_put_buckets(out, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, encoding);
+        out.insert(out.end(), light_part.counters, light_part.counters + light_mem);
+        snapshot_finish(out);
+    }
+
+    bool deserialize(const uint8_t *data, size_t len)
+    {
+        const SnapshotHeader *h = snapshot_check(data, len, SNAPSHOT_ELASTIC, bucket_num, COUNTER_PER_BUCKET);
+        if(!h || h->light_bytes != light_mem)
+            return false;
+        const uint8_t *p = data + sizeof(SnapshotHeader), *end = data + len;
+        clear();
+        if(!snapshot_get_buckets(p, end, heavy_part.buckets, bucket_num, COUNTER_PER_BUCKET, h->encoding) || end - p != light_mem)
+        {
+            clear();
+            return false;
+        }
+        memcpy(light_part.counters, p, light_mem);
+        light_part.set_seed(h->seed);
+        return true;
+    }
+
+    // Adds the counts of other; false if it has another seed. Heavy entries
+    // that no longer fit in their bucket go to the light part, as on a swap.
+    bool merge(const ElasticSketch &other)
+    {
+        if(other.light_part.seed != light_part.seed)
+            return false;
+        light_part.merge(other.light_part);
+        for(int i = 0; i < bucket_num; ++i)
+        {
+            bucket_merge(heavy_part.buckets[i].key, heavy_part.buckets[i].val,
+                         other.heavy_part.buckets[i].key, other.heavy_part.buckets[i].val,
+                         MAX_VALID_COUNTER, 0x7FFFFFFF, [&](uint32_t key, uint32_t val) {
+                if(HIGHEST_BIT_IS_1(val))
+                    light_part.insert((uint8_t*)&key, GetCounterVal(val));
+                else
+                    light_part.swap_insert((uint8_t*)&key, val);
+            });
+            heavy_part.buckets[i].val[MAX_VALID_COUNTER] += other.heavy_part.buckets[i].val[MAX_VALID_COUNTER];
+        }
+        return true;
+    }
+
+    uint32_t get_seed() { return light_part.seed; }
+
 /* interface */
     int get_compress_width(int ratio) { return light_part.get_compress_width(ratio);}
     void compress(int ratio, uint8_t *dst) {    light_part.compress(ratio, dst); }
@@ -153,9 +236,9 @@ public:
         return -entr / tot + log2(tot);
     }
 
-    void get_distribution(vector<double> &dist)
+    void get_distribution(vector<double> &dist, bool warm_start = false)
     {
-        light_part.get_distribution(dist);
+        light_part.get_distribution(dist, warm_start);
 
         for(int i = 0; i < bucket_num; ++i)
             for(int j = 0; j < MAX_VALID_COUNTER; ++j)
@@ -183,18 +266,11 @@ public:
 
     void *operator new(size_t sz)
     {
-        constexpr uint32_t alignment = 64;
-        size_t alloc_size = (2 * alignment + sz) / alignment * alignment;
-        void *ptr = ::operator new(alloc_size);
-        void *old_ptr = ptr;
-        void *new_ptr = ((char*)std::align(alignment, sz, ptr, alloc_size) + alignment);
-        ((void **)new_ptr)[-1] = old_ptr;
-
-        return new_ptr;
+        return sketch_alloc(sz);
     }
     void operator delete(void *p)
     {
-        ::operator delete(((void**)p)[-1]);
+        sketch_free(p);
     }
 };
 
@@ -31,55 +31,22 @@ public:
 		int pos = CalculateFP(key, fp);	
 
 
-		const __m256i item = _mm256_set1_epi32((int)fp);
-		__m256i *keys_p = (__m256i *)(buckets[pos].key);
-		int matched = 0;
+		int min_counter;
+		uint32_t min_val;
+		int matched_index = bucket_match_min(buckets[pos].key, fp, min_counter, min_val);
 
-		__m256i a_comp = _mm256_cmpeq_epi32(item, keys_p[0]);
-		matched = _mm256_movemask_ps((__m256)a_comp);
-
-		if (matched != 0)
+		if (matched_index >= 0)
 		{
-			//return 32 if input is zero;
-			int matched_index = _tzcnt_u32((uint32_t)matched);
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
 			buckets[pos].val[matched_index] += f;
 			return 0;
 		}
-
-
-		const uint32_t mask_base = 0x7FFFFFFF;
-		const __m256i *counters = (__m256i *)(buckets[pos].val);
-		__m256 masks = (__m256)_mm256_set1_epi32(mask_base);
-		
-		__m256 results = (_mm256_and_ps(*(__m256*)counters, masks));
-		
-	    __m256 mask2 = (__m256)_mm256_set_epi32(mask_base, 0, 0, 0, 0, 0, 0, 0);
-	   
-	    results = _mm256_or_ps(results, mask2);
-	    
-
-	    __m128i low_part = _mm_castps_si128(_mm256_extractf128_ps(results, 0));  
-	    
-	    __m128i high_part = _mm_castps_si128(_mm256_extractf128_ps(results, 1));
-
-	    __m128i x = _mm_min_epi32(low_part, high_part);
-	    __m128i min1 = _mm_shuffle_epi32(x, _MM_SHUFFLE(0,0,3,2));
-	    //#define _MM_SHUFFLE(fp3, fp2, fp1, fp0) (((fp3) << 6) | ((fp2) << 4) | ((fp1) << 2) | ((fp0)))
-	    __m128i min2 = _mm_min_epi32(x,min1);
-	    __m128i min3 = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0,0,0,1));
-	    __m128i min4 = _mm_min_epi32(min2,min3);
-	    int min_counter_val = _mm_cvtsi128_si32(min4);//
-
-	    const __m256i ct_item = _mm256_set1_epi32(min_counter_val);
-	    int ct_matched = 0;
-
-	    __m256i ct_a_comp = _mm256_cmpeq_epi32(ct_item, (__m256i)results);
-	    matched = _mm256_movemask_ps((__m256)ct_a_comp);
-	    int min_counter = _tzcnt_u32((uint32_t)matched); 
+		int min_counter_val = (int)min_val;
 
 
 		if(min_counter_val == 0)		// empty counter
 		{
+			RECORD_INSERT_OUTCOME(INSERT_EMPTY);
 			buckets[pos].key[min_counter] = fp;
 			buckets[pos].val[min_counter] = f;
 			return 0;
@@ -92,6 +59,7 @@ public:
 
 		if(!JUDGE_IF_SWAP(GetCounterVal(min_counter_val), guard_val))
 		{
+			RECORD_INSERT_OUTCOME(INSERT_GUARD);
 			buckets[pos].val[MAX_VALID_COUNTER] = guard_val;
 			return 2;
 		}
@@ -107,6 +75,7 @@ public:
 		buckets[pos].key[min_counter] = fp;
 		buckets[pos].val[min_counter] = 0x80000001;
 
+		RECORD_INSERT_OUTCOME(INSERT_SWAP);
 		return 1;
 	}
 
@@ -115,48 +84,22 @@ public:
 		uint32_t fp;
 		int pos = CalculateFP(key, fp);	
 
-		const __m256i item = _mm256_set1_epi32((int)fp);
-		__m256i *keys_p = (__m256i *)(buckets[pos].key);
-		int matched = 0;
+		int min_counter;
+		uint32_t min_val;
+		int matched_index = bucket_match_min(buckets[pos].key, fp, min_counter, min_val);
 
-		__m256i a_comp = _mm256_cmpeq_epi32(item, keys_p[0]);
-		matched = _mm256_movemask_ps((__m256)a_comp);
-
-		if (matched != 0)
+		if (matched_index >= 0)
 		{
-			int matched_index = _tzcnt_u32((uint32_t)matched);
+			RECORD_INSERT_OUTCOME(INSERT_HIT);
 			buckets[pos].val[matched_index] += f;
 			return 0;
 		}
-
-
-		const uint32_t mask_base = 0x7FFFFFFF;
-		const __m256i *counters = (__m256i *)(buckets[pos].val);
-		__m256 masks = (__m256)_mm256_set1_epi32(mask_base);
-		__m256 results = (_mm256_and_ps(*(__m256*)counters, masks));
-	    __m256 mask2 = (__m256)_mm256_set_epi32(mask_base, 0, 0, 0, 0, 0, 0, 0);
-	    results = _mm256_or_ps(results, mask2);
-
-	    __m128i low_part = _mm_castps_si128(_mm256_extractf128_ps(results, 0));
-	    __m128i high_part = _mm_castps_si128(_mm256_extractf128_ps(results, 1));
-
-	    __m128i x = _mm_min_epi32(low_part, high_part);
-	    __m128i min1 = _mm_shuffle_epi32(x, _MM_SHUFFLE(0,0,3,2));
-	    __m128i min2 = _mm_min_epi32(x,min1);
-	    __m128i min3 = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0,0,0,1));
-	    __m128i min4 = _mm_min_epi32(min2,min3);
-	    int min_counter_val = _mm_cvtsi128_si32(min4);
-
-	    const __m256i ct_item = _mm256_set1_epi32(min_counter_val);
-	    int ct_matched = 0;
-
-	    __m256i ct_a_comp = _mm256_cmpeq_epi32(ct_item, (__m256i)results);
-	    matched = _mm256_movemask_ps((__m256)ct_a_comp);
-	    int min_counter = _tzcnt_u32((uint32_t)matched);
+		int min_counter_val = (int)min_val;
 
 
 		if(min_counter_val == 0)		
 		{
+			RECORD_INSERT_OUTCOME(INSERT_EMPTY);
 			buckets[pos].key[min_counter] = fp;
 			buckets[pos].val[min_counter] = f;
 			return 0;
@@ -168,6 +111,7 @@ public:
 
 		if(!JUDGE_IF_SWAP(min_counter_val, guard_val))
 		{
+			RECORD_INSERT_OUTCOME(INSERT_GUARD);
 			buckets[pos].val[MAX_VALID_COUNTER] = guard_val;
 			return 2;
 		}
@@ -176,6 +120,7 @@ public:
 		buckets[pos].val[MAX_VALID_COUNTER] = 0;
 
 		buckets[pos].key[min_counter] = fp;
+		RECORD_INSERT_OUTCOME(INSERT_SWAP);
 		return 1;
 	}
 
@@ -192,6 +137,13 @@ public:
 		return 0;
 	}
 
+	// loads the bucket of key ahead of a query
+	void prefetch(const uint8_t *key)
+	{
+		uint32_t fp;
+		_mm_prefetch((const char*)&buckets[CalculateFP((uint8_t*)key, fp)], _MM_HINT_T0);
+	}
+
 
 /* interface */
 	int get_memory_usage()
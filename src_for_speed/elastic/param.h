@@ -2,6 +2,10 @@
 #define _PARAM_H_
 
 #include "../common/BOBHash32.h"
+#include "../common/bucket_kernel.h"
+#include "../common/latency_hist.h"
+#include "../common/sketch_snapshot.h"
+#include "../common/sketch_alloc.h"
 
 #include <x86intrin.h>
 #include <string.h>
@@ -26,6 +30,9 @@
 #define KEY_LENGTH_4 4
 #define KEY_LENGTH_13 13
 
+// keys hashed ahead by the batched queries
+#define QUERY_BATCH 64
+
 #define CONSTANT_NUMBER 2654435761u
 #define CalculateBucketPos(fp) (((fp) * CONSTANT_NUMBER) >> 15)
 